@@ -2,10 +2,17 @@
 #define EVAL_HPP
 
 #include "chess.hpp"
+#include "EvalWeights.hpp"
+#include "Nnue.hpp"
+#include "PawnHashTable.hpp"
+#include "PositionRecord.hpp"
+#include "Score.hpp"
 #include <iostream>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <array>
+#include <cstdint>
 
 namespace { // To avoid polluting the global namespace
     using Bitboard = chess::Bitboard;
@@ -45,6 +52,15 @@ namespace BitOp
     {
         return (color == Color::WHITE) ? bitboard >> 8 : bitboard << 8;
     }
+    /// @brief shift_backward for a color known at compile time, a single shift.
+    template <Color::underlying C>
+    Bitboard shift_backward(Bitboard bitboard)
+    {
+        if constexpr (C == Color::WHITE)
+            return bitboard >> 8;
+        else
+            return bitboard << 8;
+    }
     /*
     Shifts all bits down (towards the white pieces).
     @param bitboard chess::Bitboard object */
@@ -63,6 +79,15 @@ namespace BitOp
     {
         return (color == Color::WHITE) ? bitboard << 8 : bitboard >> 8;
     }
+    /// @brief shift_forward for a color known at compile time, a single shift.
+    template <Color::underlying C>
+    Bitboard shift_forward(Bitboard bitboard)
+    {
+        if constexpr (C == Color::WHITE)
+            return bitboard << 8;
+        else
+            return bitboard >> 8;
+    }
     /*
     Shifts all bits up (towards the black pieces).
     @param bitboard chess::Bitboard object */
@@ -72,42 +97,73 @@ namespace BitOp
         return shift_forward(bitboard, Color::WHITE);
     }
     /*
-    Expands the bits of a bitboard such that each bit set to 1 in the original
-    bitboard will set all surrounding bits (diagonally, horizontally, and vertically) to 1.
-    @param bitboard chess::Bitboard object*/
-    Bitboard expand_bits(Bitboard bitboard)
-    {
-        Bitboard left_shift = shift_left(bitboard);
-        Bitboard right_shift = shift_right(bitboard);
-        Bitboard up_shift = shift_up(bitboard);
-        Bitboard down_shift = shift_down(bitboard);
-        Bitboard up_left = shift_left(up_shift);
-        Bitboard up_right = shift_right(up_shift);
-        Bitboard down_left = shift_left(down_shift);
-        Bitboard down_right = shift_right(down_shift);
-
-        return bitboard | left_shift | right_shift | up_shift | down_shift | up_left | up_right | down_left | down_right;
+    Number of files with at least one bit set.
+    @param bitboard chess::Bitboard object */
+    inline int occupied_files(Bitboard bitboard)
+    {
+        std::uint64_t bits = bitboard.getBits();
+        bits |= bits >> 32;
+        bits |= bits >> 16;
+        bits |= bits >> 8;
+        return Bitboard(bits & 0xFF).count();
     }
     /*
-    Expands the bits of a bitboard such that each bit set to 1 in the original
-    bitboard will set all surrounding bits (diagonally, horizontally, and vertically) to 1. Then sets the original evaluated bit to 0.
-    Not meant for use with bitboards that have more than one bit as unpredictable results may occur.
-    @param bitboard chess::Bitboard object*/
-    Bitboard get_surrounding_bits(Bitboard bitboard)
-    {
-        Bitboard left_shift = shift_left(bitboard);
-        Bitboard right_shift = shift_right(bitboard);
-        Bitboard up_shift = shift_up(bitboard);
-        Bitboard down_shift = shift_down(bitboard);
-        Bitboard up_left = shift_left(up_shift);
-        Bitboard up_right = shift_right(up_shift);
-        Bitboard down_left = shift_left(down_shift);
-        Bitboard down_right = shift_right(down_shift);
-
-        return ~bitboard | left_shift | right_shift | up_shift | down_shift | up_left | up_right | down_left | down_right;
+    Number of ranks with at least one bit set. Each rank is folded onto its lowest bit; folding
+    only moves bits down within a byte by the time the lowest bit is read, so ranks do not mix.
+    @param bitboard chess::Bitboard object */
+    inline int occupied_ranks(Bitboard bitboard)
+    {
+        std::uint64_t bits = bitboard.getBits();
+        bits |= bits >> 4;
+        bits |= bits >> 2;
+        bits |= bits >> 1;
+        return Bitboard(bits & 0x0101010101010101ULL).count();
     }
 };
 
+/*
+Masks the evaluation needs per square, built at compile time so the passes look them up
+instead of constructing File and Rank bitboards and shifting them on every call.
+The ring around a king is chess::attacks::king(), which chess.hpp already keeps as a table. */
+namespace Masks
+{
+    inline constexpr std::array<Bitboard, 64> file = []
+    {
+        std::array<Bitboard, 64> masks{};
+        for (int sq = 0; sq < 64; ++sq)
+            masks[sq] = Bitboard(0x0101010101010101ULL << (sq & 7));
+        return masks;
+    }();
+
+    inline constexpr std::array<Bitboard, 64> rank = []
+    {
+        std::array<Bitboard, 64> masks{};
+        for (int sq = 0; sq < 64; ++sq)
+            masks[sq] = Bitboard(0xFFULL << (sq & 56));
+        return masks;
+    }();
+
+    // The files next to the square's file, one or two of them.
+    inline constexpr std::array<Bitboard, 64> adjacent_files = []
+    {
+        std::array<Bitboard, 64> masks{};
+        for (int sq = 0; sq < 64; ++sq)
+        {
+            const int f = sq & 7;
+            std::uint64_t bits = 0;
+            if (f > 0)
+                bits |= 0x0101010101010101ULL << (f - 1);
+            if (f < 7)
+                bits |= 0x0101010101010101ULL << (f + 1);
+            masks[sq] = Bitboard(bits);
+        }
+        return masks;
+    }();
+
+    // d4, e4, d5 and e5.
+    inline constexpr Bitboard center = Bitboard(0x0000001818000000ULL);
+}
+
 // Other helper functions:
 namespace Helper
 {
@@ -127,14 +183,32 @@ namespace Helper
         return !is_empty(b1, b2);
     }
 
-    /// @brief Returns a hashmap of the pieces attacking the square.
+    /// @brief Attackers of one square, counted per piece type. Fixed size, lives on the stack.
+    struct AttackerCount
+    {
+        std::array<int, 6> counts = {}; // Indexed by PieceType
+
+        int &operator[](PieceType pt) { return counts[static_cast<int>(pt)]; }
+        int operator[](PieceType pt) const { return counts[static_cast<int>(pt)]; }
+
+        /// @brief Sums up the total number of attackers
+        int total() const
+        {
+            int k = 0;
+            for (int count : counts)
+                k += count;
+            return k;
+        }
+    };
+
+    /// @brief Returns the piece types attacking the square.
     /// @param board The chess board
     /// @param square The square to check for attacks
     /// @param color The color of the attacking pieces
-    /// @return A hashmap of the pieces attacking the square and their counts
-    static std::unordered_map<PieceType, int> isAttackedCount(const chess::Board &board, chess::Square square, Color color)
+    /// @return The number of attacks per piece type. Each type is counted once, however many pieces of it attack.
+    inline AttackerCount isAttackedCount(const chess::Board &board, chess::Square square, Color color)
     {
-        std::unordered_map<PieceType, int> attackers_count;
+        AttackerCount attackers_count;
 
         // Pawn attackes
         if (chess::attacks::pawn(~color, square) & board.pieces(PieceType::PAWN, color))
@@ -164,21 +238,188 @@ namespace Helper
     }
 
     /// @brief Sums up the total number of attackers
-    /// @param map the unordered_map of attackers, called by isAttackedCount
-    int total_attackers(const std::unordered_map<PieceType, int> &map)
+    /// @param count the attackers, as returned by isAttackedCount
+    inline int total_attackers(const AttackerCount &count)
     {
-        int k = 0;
-        for (auto count : map)
-            k += count.second;
-        return k;
+        return count.total();
+    }
+
+    /*
+    Every square attacked by each side, computed in one pass over the pieces.
+    by_type holds the union per piece type, piece_attacks the attacks of the single
+    piece standing on a square (only meaningful for occupied squares). */
+    struct AttackMaps
+    {
+        std::array<std::array<Bitboard, 6>, 2> by_type = {}; // [color][piece type]
+        std::array<Bitboard, 2> all = {};                    // [color]
+        std::array<Bitboard, 64> piece_attacks = {};         // [square]
+
+        static AttackMaps compute(const chess::Board &board)
+        {
+            AttackMaps maps;
+            const Bitboard occupied = board.occ();
+            for (Color color : {Color(Color::WHITE), Color(Color::BLACK)})
+            {
+                for (PieceType::underlying piece_type : {PieceType::PAWN, PieceType::KNIGHT, PieceType::BISHOP,
+                                                         PieceType::ROOK, PieceType::QUEEN, PieceType::KING})
+                {
+                    Bitboard pieces = board.pieces(piece_type, color);
+                    Bitboard &union_bb = maps.by_type[color][static_cast<int>(PieceType(piece_type))];
+                    while (pieces)
+                    {
+                        chess::Square sq = pieces.pop();
+                        Bitboard attacks;
+                        switch (piece_type)
+                        {
+                        case PieceType::PAWN:
+                            attacks = chess::attacks::pawn(color, sq);
+                            break;
+                        case PieceType::KNIGHT:
+                            attacks = chess::attacks::knight(sq);
+                            break;
+                        case PieceType::BISHOP:
+                            attacks = chess::attacks::bishop(sq, occupied);
+                            break;
+                        case PieceType::ROOK:
+                            attacks = chess::attacks::rook(sq, occupied);
+                            break;
+                        case PieceType::QUEEN:
+                            attacks = chess::attacks::queen(sq, occupied);
+                            break;
+                        default:
+                            attacks = chess::attacks::king(sq);
+                            break;
+                        }
+                        maps.piece_attacks[sq.index()] = attacks;
+                        union_bb |= attacks;
+                    }
+                    maps.all[color] |= union_bb;
+                }
+            }
+            return maps;
+        }
+
+        /// @brief Same result as isAttackedCount, read from the precomputed maps.
+        AttackerCount attackers(chess::Square square, Color color) const
+        {
+            AttackerCount count;
+            const Bitboard sq_bb = Bitboard::fromSquare(square);
+            for (int pt = 0; pt < 6; ++pt)
+                count.counts[pt] = Helper::any(by_type[color][pt], sq_bb) ? 1 : 0;
+            return count;
+        }
+    };
+
+    // Flips a table vertically so a black table can be read from white's side. Runs at compile time.
+    constexpr std::array<int, 64> mirror_table(const std::array<int, 64> &table)
+    {
+        std::array<int, 64> mirrored_table = {};
+        for (int rank = 0; rank < 8; ++rank)
+        {
+            for (int file = 0; file < 8; ++file)
+            {
+                int src_index = rank * 8 + file;
+                int dest_index = (7 - rank) * 8 + file;
+                mirrored_table[dest_index] = table[src_index];
+            }
+        }
+        return mirrored_table;
     }
 };
 
+namespace Helper
+{
+    // A piece's material value plus its table value on each square, as mg/eg pairs. Runs at compile time.
+    constexpr std::array<Score, 64> piece_square_scores(int value, const std::array<int, 64> &mg_table, const std::array<int, 64> &eg_table, int sign)
+    {
+        std::array<Score, 64> scores = {};
+        for (int sq = 0; sq < 64; ++sq)
+            scores[sq] = sign * make_score(value + mg_table[sq], value + eg_table[sq]);
+        return scores;
+    }
+}
+
+// Define EVAL_TRACE before including this header to record, per evaluation, how often each weight was applied.
+#ifdef EVAL_TRACE
+constexpr bool EVAL_TRACE_ENABLED = true;
+#else
+constexpr bool EVAL_TRACE_ENABLED = false;
+#endif
+
+// The weights of EvalWeights.hpp, in the same order.
+enum EvalTerm
+{
+    DOUBLED_PAWNS,
+    ISOLATED_PAWNS,
+    PASSED_PAWNS,
+    PAWN_CENTER,
+    VALUABLE_PAWN_CAPTURES,
+    BACKWARDS_PAWNS,
+    PAWN_CHAIN,
+    BISHOP_MOBILITY,
+    BISHOP_CENTER,
+    ROOK_OPEN_FILE,
+    STACKED_ROOKS,
+    ROOK_MOBILITY,
+    KNIGHT_MOBILITY,
+    KING_RESTRICTION,
+    CHECKS,
+    QUEEN_CHECKS,
+    KING_DOUBLE_ATTACK,
+    EVAL_TERM_COUNT
+};
+
+/*
+What the last evaluation on this thread was made of: the untapered total, the phase, and
+for every weight the signed number of times it was added (white minus black, negative for
+penalties). The total minus every coefficient times its weight is the part no weight touches.
+Only filled in EVAL_TRACE builds, which is what the tuner is. Pawn structure terms are only
+traced when they are computed, not when they come from the pawn hash. */
+struct EvalTrace
+{
+    std::array<int, EVAL_TERM_COUNT> coefficients = {};
+    Score total = 0;
+    int phase = 0;
+};
+
+inline thread_local EvalTrace eval_trace;
+
+inline void trace_term(EvalTerm term, int coefficient)
+{
+    if constexpr (EVAL_TRACE_ENABLED)
+        eval_trace.coefficients[term] += coefficient;
+}
+
+class EvalBoard;
+
+/*
+Material and piece-square sums, white minus black, and the game phase. These are the linear
+part of the evaluation: each piece contributes independently of the others, so they can be
+kept up to date one piece at a time as moves are made and unmade (see EvalBoard). Both
+phases are kept in one packed pair, so a piece change is a single add whatever the phase. */
+struct EvalAccumulator
+{
+    Score psqt = 0; // Material plus piece-square tables
+    int phase = 0;  // Sum of Evaluation::phase_weights over the pieces on the board
+
+    inline void add(chess::Piece piece, chess::Square sq);
+    inline void remove(chess::Piece piece, chess::Square sq);
+    inline static EvalAccumulator from_board(const chess::Board &board);
+
+    bool operator==(const EvalAccumulator &other) const = default;
+
+private:
+    inline void update(chess::Piece piece, chess::Square sq, int sign);
+};
+
 class Evaluation
 {
 private:
-    chess::Board data;
+    friend struct EvalAccumulator;
+
+    const chess::Board &data;
     Color side;
+    EvalAccumulator accumulator; // Copied from an EvalBoard, or built from scratch
     Bitboard white_pawns;
     Bitboard black_pawns;
     Bitboard white_bishops;
@@ -194,9 +435,10 @@ private:
     Bitboard white_pieces;
     Bitboard black_pieces;
     Bitboard all_pieces;
+    const Helper::AttackMaps *attacks = nullptr; // Both sides' attacks, on the stack of the full evaluation that computed them
 
     // Black chess-piece/position boards:
-    std::array<int, 64> black_pawn_table = {
+    static constexpr std::array<int, 64> black_pawn_table = {
         0, 0, 0, 0, 0, 0, 0, 0,
         50, 50, 50, 50, 50, 50, 50, 50,
         10, 10, 20, 30, 30, 20, 10, 10,
@@ -205,7 +447,7 @@ private:
         5, -5, -10, -10, -10, -10, -5, 5,
         5, 10, 10, -20, -20, 10, 10, 5,
         0, 0, 0, 0, 0, 0, 0, 0};
-    std::array<int, 64> black_knight_table = {
+    static constexpr std::array<int, 64> black_knight_table = {
         -50, -40, -30, -30, -30, -30, -40, -50,
         -40, -20, 0, 0, 0, 0, -20, -40,
         -30, 0, 10, 15, 15, 10, 0, -30,
@@ -214,7 +456,7 @@ private:
         -30, 5, 10, 15, 15, 10, 5, -30,
         -40, -20, 0, 5, 5, 0, -20, -40,
         -50, -40, -30, -30, -30, -30, -40, -50};
-    std::array<int, 64> black_bishop_table = {
+    static constexpr std::array<int, 64> black_bishop_table = {
         -20, -10, -10, -10, -10, -10, -10, -20,
         -10, 0, 0, 0, 0, 0, 0, -10,
         -10, 0, 5, 10, 10, 5, 0, -10,
@@ -223,7 +465,7 @@ private:
         -10, 10, 10, 10, 10, 10, 10, -10,
         -10, 10, 0, 0, 0, 0, 10, -10,
         -20, -10, -10, -10, -10, -10, -10, -20};
-    std::array<int, 64> black_rook_table = {
+    static constexpr std::array<int, 64> black_rook_table = {
         0, 0, 0, 0, 0, 0, 0, 0,
         5, 10, 10, 10, 10, 10, 10, 5,
         -5, 0, 0, 0, 0, 0, 0, -5,
@@ -232,7 +474,7 @@ private:
         -5, 0, 0, 0, 0, 0, 0, -5,
         -5, 0, 0, 0, 0, 0, 0, -5,
         0, 0, 0, 5, 5, 0, 0, 0};
-    std::array<int, 64> early_black_queen_table = {
+    static constexpr std::array<int, 64> early_black_queen_table = {
         -30, -20, -20, -20, -20, -20, -20, -30,
         -20, -20, -10, -10, -10, -10, -20, -20,
         -20, -10, -5, -5, -5, -5, -10, -20,
@@ -241,7 +483,7 @@ private:
         -20, -10, -5, -5, -5, -5, -10, -20,
         -20, -20, 100, 100, 100, 100, -20, -20,
         -30, 50, 120, 150, 150, 120, 50, -30};
-    std::array<int, 64> late_black_queen_table = {
+    static constexpr std::array<int, 64> late_black_queen_table = {
         -20, -10, -10, -5, -5, -10, -10, -20,
         -10, 0, 0, 0, 0, 0, 0, -10,
         -10, 0, 5, 5, 5, 5, 0, -10,
@@ -250,7 +492,7 @@ private:
         -10, 5, 5, 5, 5, 5, 0, -10,
         -10, 0, 5, 0, 0, 0, 0, -10,
         -20, -10, -10, -5, -5, -10, -10, -20};
-    std::array<int, 64> black_king_table = {
+    static constexpr std::array<int, 64> black_king_table = {
         -30, -40, -40, -50, -50, -40, -40, -30,
         -30, -40, -40, -50, -50, -40, -40, -30,
         -30, -40, -40, -50, -50, -40, -40, -30,
@@ -259,70 +501,102 @@ private:
         -10, -20, -20, -20, -20, -20, -20, -10,
         20, 20, 0, 0, 0, 0, 20, 20,
         20, 30, 10, 0, 0, 10, 30, 20};
-
-    std::array<int, 64> white_pawn_table;
-    std::array<int, 64> white_knight_table;
-    std::array<int, 64> white_bishop_table;
-    std::array<int, 64> white_rook_table;
-    std::array<int, 64> early_white_queen_table;
-    std::array<int, 64> late_white_queen_table;
-    std::array<int, 64> white_king_table;
-
-    std::array<int, 64> mirror_table(const std::array<int, 64> &table) const
-    {
-        std::array<int, 64> mirrored_table;
-        for (int rank = 0; rank < 8; ++rank)
-        {
-            for (int file = 0; file < 8; ++file)
-            {
-                int src_index = rank * 8 + file;
-                int dest_index = (7 - rank) * 8 + file;
-                mirrored_table[dest_index] = table[src_index];
-            }
-        }
-        return mirrored_table;
-    }
-
-    // These are for tracking piece positions on board:
-    int pawn_position_score = 0;
-    int knight_position_score = 0;
-    int bishop_position_score = 0;
-    int rook_position_score = 0;
-    int queen_position_score = 0;
-    int king_position_score = 0;
-    int pins_and_checks_score = 0;
-
-    std::unordered_map<PieceType, int> material_value_map;
-
-    // Constants. Will be optimized by machine learning model later. Currently has no getters/setters.
+    static constexpr std::array<int, 64> late_black_king_table = {
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10, 0, 0, -10, -20, -30,
+        -30, -10, 20, 30, 30, 20, -10, -30,
+        -30, -10, 30, 40, 40, 30, -10, -30,
+        -30, -10, 30, 40, 40, 30, -10, -30,
+        -30, -10, 20, 30, 30, 20, -10, -30,
+        -30, -30, 0, 0, 0, 0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50};
+
+    // White tables are mirrored at compile time and shared by every Evaluation.
+    static constexpr std::array<int, 64> white_pawn_table = Helper::mirror_table(black_pawn_table);
+    static constexpr std::array<int, 64> white_knight_table = Helper::mirror_table(black_knight_table);
+    static constexpr std::array<int, 64> white_bishop_table = Helper::mirror_table(black_bishop_table);
+    static constexpr std::array<int, 64> white_rook_table = Helper::mirror_table(black_rook_table);
+    static constexpr std::array<int, 64> early_white_queen_table = Helper::mirror_table(early_black_queen_table);
+    static constexpr std::array<int, 64> late_white_queen_table = Helper::mirror_table(late_black_queen_table);
+    static constexpr std::array<int, 64> white_king_table = Helper::mirror_table(black_king_table);
+    static constexpr std::array<int, 64> late_white_king_table = Helper::mirror_table(late_black_king_table);
+
+
+    // These are for tracking piece positions on board. The per-piece table sums live in accumulator.
+    Score king_position_score = 0;
+    Score pins_and_checks_score = 0;
+    bool pawn_hash_hit = false; // Set by cached_pawn_structure()
+
+    // Constants, as (middlegame, endgame) pairs. The values live in EvalWeights.hpp, which tune.cpp regenerates.
     // Pawn:
-    static constexpr int doubled_pawn_penalty = 20;
-    static constexpr int isolated_pawn_penalty = 20;
-    static constexpr int passed_pawn_bonus = 50;
-    static constexpr int pawn_center_control = 100;
-    static constexpr int valuable_pawn_captures_bonus = 5;
-    static constexpr int backwards_pawn_penalty = 20;
-    static constexpr int pawn_chain_bonus = 30;
+    static constexpr Score doubled_pawn_penalty = EvalWeights::doubled_pawn_penalty;
+    static constexpr Score isolated_pawn_penalty = EvalWeights::isolated_pawn_penalty;
+    static constexpr Score passed_pawn_bonus = EvalWeights::passed_pawn_bonus;
+    static constexpr Score pawn_center_control = EvalWeights::pawn_center_control;
+    static constexpr Score valuable_pawn_captures_bonus = EvalWeights::valuable_pawn_captures_bonus;
+    static constexpr Score backwards_pawn_penalty = EvalWeights::backwards_pawn_penalty;
+    static constexpr Score pawn_chain_bonus = EvalWeights::pawn_chain_bonus;
 
     // Bishop
-    static constexpr int bishop_mobility_bonus = 5;
-    static constexpr int bishop_center_bonus = 40;
+    static constexpr Score bishop_mobility_bonus = EvalWeights::bishop_mobility_bonus;
+    static constexpr Score bishop_center_bonus = EvalWeights::bishop_center_bonus;
 
     // Rook
-    static constexpr int rook_open_file_bonus = 35;
-    static constexpr int stacked_rooks_bonus = 25;
-    static constexpr int rook_mobility_bonus = 5;
+    static constexpr Score rook_open_file_bonus = EvalWeights::rook_open_file_bonus;
+    static constexpr Score stacked_rooks_bonus = EvalWeights::stacked_rooks_bonus;
+    static constexpr Score rook_mobility_bonus = EvalWeights::rook_mobility_bonus;
 
     // Knight
-    static constexpr int knight_mobility_bonus = 25;
+    static constexpr Score knight_mobility_bonus = EvalWeights::knight_mobility_bonus;
 
     // All:
-    static constexpr int king_restriction_bonus = 8;
-    static constexpr int checks_constant = 25;
+    static constexpr Score king_restriction_bonus = EvalWeights::king_restriction_bonus;
+    static constexpr Score checks_constant = EvalWeights::checks_constant;
+    static constexpr Score queen_check_bonus = EvalWeights::queen_check_bonus; // Only counts once the middlegame is over
+    static constexpr Score king_double_attack_penalty = EvalWeights::king_double_attack_penalty;
 
 public:
-    Evaluation(chess::Board data, Color side) : data(data),
+    // Material values, indexed by PieceType. Kings carry no material.
+    static constexpr std::array<int, 6> piece_values = {100, 300, 350, 500, 900, 0};
+
+    // Game phase weights per PieceType. The starting position adds up to MAX_PHASE, pawns and kings alone to 0.
+    static constexpr std::array<int, 6> phase_weights = {0, 1, 1, 2, 4, 0};
+    static constexpr int MAX_PHASE = 24;
+
+    // Most the terms evaluate_lazy() may skip are trusted to move the score, in centipawns.
+    static constexpr int LAZY_EVAL_MARGIN = 400;
+
+    // Material plus table value of every piece on every square, black pieces negated. Indexed by chess::Piece.
+    static constexpr std::array<std::array<Score, 64>, 12> psqt = {
+        Helper::piece_square_scores(piece_values[0], white_pawn_table, white_pawn_table, 1),
+        Helper::piece_square_scores(piece_values[1], white_knight_table, white_knight_table, 1),
+        Helper::piece_square_scores(piece_values[2], white_bishop_table, white_bishop_table, 1),
+        Helper::piece_square_scores(piece_values[3], white_rook_table, white_rook_table, 1),
+        Helper::piece_square_scores(piece_values[4], early_white_queen_table, late_white_queen_table, 1),
+        Helper::piece_square_scores(piece_values[5], white_king_table, late_white_king_table, 1),
+        Helper::piece_square_scores(piece_values[0], black_pawn_table, black_pawn_table, -1),
+        Helper::piece_square_scores(piece_values[1], black_knight_table, black_knight_table, -1),
+        Helper::piece_square_scores(piece_values[2], black_bishop_table, black_bishop_table, -1),
+        Helper::piece_square_scores(piece_values[3], black_rook_table, black_rook_table, -1),
+        Helper::piece_square_scores(piece_values[4], early_black_queen_table, late_black_queen_table, -1),
+        Helper::piece_square_scores(piece_values[5], black_king_table, late_black_king_table, -1)};
+
+    /// @brief Blends the two halves of a score by game phase: all middlegame at MAX_PHASE, all endgame at 0.
+    static constexpr int taper(Score score, int phase)
+    {
+        phase = std::min(phase, MAX_PHASE); // Promotions can push the phase past the start position's
+        return (mg_value(score) * phase + eg_value(score) * (MAX_PHASE - phase)) / MAX_PHASE;
+    }
+
+    // Evaluates from scratch.
+    Evaluation(const chess::Board &data, Color side) : Evaluation(data, side, EvalAccumulator::from_board(data)) {}
+
+    // Reuses the sums the board kept up to date while moves were made.
+    inline Evaluation(const EvalBoard &data, Color side);
+
+    Evaluation(const chess::Board &data, Color side, const EvalAccumulator &accumulator) : data(data),
                                                 side(side),
+                                                accumulator(accumulator),
                                                 white_pawns(data.pieces(PieceType::PAWN, Color::WHITE)),
                                                 black_pawns(data.pieces(PieceType::PAWN, Color::BLACK)),
                                                 white_bishops(data.pieces(PieceType::BISHOP, Color::WHITE)),
@@ -339,13 +613,27 @@ public:
                                                 black_pieces(data.us(Color::BLACK)),
                                                 all_pieces(data.occ())
     {
-        white_pawn_table = mirror_table(black_pawn_table);
-        white_knight_table = mirror_table(black_knight_table);
-        white_bishop_table = mirror_table(black_bishop_table);
-        white_rook_table = mirror_table(black_rook_table);
-        early_white_queen_table = mirror_table(early_black_queen_table);
-        late_white_queen_table = mirror_table(late_black_queen_table);
-        white_king_table = mirror_table(black_king_table);
+    }
+
+    /*
+    The per-side passes below are templates on the side they evaluate, like chess.hpp's move
+    generation: the sign of a term and the direction pawns move are then constants, and each
+    pass compiles to a white and a black copy without color tests. */
+
+    // The squares around the king of C's opponent, where C's attacks restrict it.
+    template <Color::underlying C>
+    Bitboard enemy_king_ring() const
+    {
+        return chess::attacks::king(chess::Square((C == Color::WHITE ? black_king : white_king).lsb()));
+    }
+
+    // Adds one application of a weight to the side's pins_and_checks_score.
+    template <Color::underlying C>
+    void add_king_pressure(EvalTerm term, Score weight)
+    {
+        constexpr int sign = C == Color::WHITE ? 1 : -1;
+        pins_and_checks_score += sign * weight;
+        trace_term(term, sign);
     }
 
     int naive_material_balance()
@@ -359,183 +647,138 @@ public:
                 Bitboard pieces = data.pieces(piece_type, color);
                 int count = pieces.count();
 
-                // Value of pieces
-                int piece_value = 0;
-                switch (piece_type)
-                {
-                case PieceType::PAWN:
-                    material_value_map[PieceType::PAWN] = 100;
-                    break;
-                case PieceType::KNIGHT:
-                    material_value_map[PieceType::KNIGHT] = 300;
-                    break;
-                case PieceType::BISHOP:
-                    material_value_map[PieceType::BISHOP] = 350;
-                    break;
-                case PieceType::ROOK:
-                    material_value_map[PieceType::ROOK] = 500;
-                    break;
-                case PieceType::QUEEN:
-                    material_value_map[PieceType::QUEEN] = 900;
-                    break;
-                default:
-                    break;
-                }
                 // (+) if white, (-) if black
-                balance += (count * material_value_map[piece_type] * (color == Color::WHITE ? 1 : -1));
+                balance += (count * piece_values[static_cast<int>(piece_type)] * (color == Color::WHITE ? 1 : -1));
             }
         }
         return balance;
     }
 
-    // Evaluating Pawns
-    void pawn_structure(Bitboard allied_pawns, Bitboard enemy_pawns, int &doubled_pawns, int &isolated_pawns,
-                        int &passed_pawns, int &center, int &valuable_pawn_captures, int &backwards_pawns, int &pawn_chain, Bitboard enemy_king,
-                        Bitboard enemy_pieces, const Color &color)
+    // Evaluating Pawns. Only reads the two pawn bitboards, which is what lets cached_pawn_structure() cache the result.
+    template <Color::underlying C>
+    static void pawn_structure(Bitboard allied_pawns, Bitboard enemy_pawns, int &doubled_pawns, int &isolated_pawns,
+                               int &passed_pawns, int &center, int &backwards_pawns, int &pawn_chain)
     {
         // Doubled Pawns (-): Weak due to vulnerable position
         // Isolated Pawns (-): Weak due to no pawns on adjacent files
         // Passed Pawns (+): Strong due to no enemy pawn interference
         // Backwards Pawns (-): Easily targeted, and also gives opponent outpost squares
         // Pawn chain (+): Pawn chains are hard to attack. Counts each instance of a pawn supporting another.
-        int allied_pawns_count = allied_pawns.count();
-        if (allied_pawns_count == 0)
+        if (!allied_pawns)
             return; // No pawns, no point evaluating.
-        std::vector<chess::Square> pawn_positions;
-        pawn_positions.reserve(allied_pawns_count);
 
-        for (int index = 0; index < 8; ++index)
+        // One pass per file that has pawns: the terms count the pawns of a file together.
+        Bitboard remaining = allied_pawns;
+        while (remaining)
         {
-            File file(static_cast<File::underlying>(index));
-            Bitboard file_bb(file);
-            Rank rank(static_cast<Rank::underlying>(index));
-            Bitboard rank_bb(rank);
-            Bitboard adj_files_left = BitOp::shift_left(file_bb);
-            Bitboard adj_files_right = BitOp::shift_right(file_bb);
-            Bitboard pawn_captures_bb = BitOp::shift_left(BitOp::shift_forward(allied_pawns, color) & file_bb) | BitOp::shift_right(BitOp::shift_forward(allied_pawns, color) & file_bb);
-
-            int count = (allied_pawns & file_bb).count();
-
-            // Check pawn is on file
-            if (count > 0)
-            {
-                // Doubled Pawns: increments by 1 if number of pawns on same rank is more than 1.
-                if (count > 1)
-                    doubled_pawns += count - 1;
-
-                // Isolated Pawns:
-                if (Helper::is_empty(allied_pawns, adj_files_left) && Helper::is_empty(allied_pawns, adj_files_right))
-                {
-                    isolated_pawns += count;
-                }
+            const int square = remaining.lsb();
+            const Bitboard file_bb = Masks::file[square];
+            const Bitboard file_pawns = allied_pawns & file_bb;
+            remaining &= ~file_bb;
+            const Bitboard pawn_captures_bb = BitOp::shift_left(BitOp::shift_forward<C>(file_pawns)) | BitOp::shift_right(BitOp::shift_forward<C>(file_pawns));
 
-                // Passed Pawns:
-                if (Helper::is_empty(enemy_pawns, (adj_files_left | file_bb | adj_files_right)))
-                {
-                    passed_pawns += count;
-                }
+            int count = file_pawns.count();
 
-                // Captures:
-                // Shifts bitboard into capturable spots. First half returns bitboard of capturable squares for the each pawn, second half finds enemy_pieces that are not pawns.
-                valuable_pawn_captures += (pawn_captures_bb & (~enemy_pawns & enemy_pieces)).count();
+            // Doubled Pawns: increments by 1 if number of pawns on same rank is more than 1.
+            if (count > 1)
+                doubled_pawns += count - 1;
 
-                // Checks and attacks on king:
-                if (Helper::any(pawn_captures_bb, enemy_king))
-                {
-                    pins_and_checks_score += (color == Color::WHITE ? checks_constant : -checks_constant);
-                }
+            // Isolated Pawns:
+            if (Helper::is_empty(allied_pawns, Masks::adjacent_files[square]))
+            {
+                isolated_pawns += count;
+            }
 
-                // Restricting King movement:
-                if (Helper::any(pawn_captures_bb, BitOp::get_surrounding_bits(enemy_king)))
-                {
-                    pins_and_checks_score += (color == Color::WHITE ? king_restriction_bonus : -king_restriction_bonus);
-                }
+            // Passed Pawns:
+            if (Helper::is_empty(enemy_pawns, Masks::adjacent_files[square] | file_bb))
+            {
+                passed_pawns += count;
+            }
 
-                // Backwards pawns & pawn chain:
-                int pos_captures = (pawn_captures_bb & allied_pawns).count();
-                if (pos_captures == 2)
-                {
-                    backwards_pawns++;          // Backwards Pawn
-                    pawn_chain += pos_captures; // Increment pawn chain bonus by 2
-                }
-                else if (pos_captures == 1)
-                {
-                    pawn_chain++; // Increment pawn chain bonus
-                    if (Helper::any(pawn_captures_bb, adj_files_left))
-                    { // Allied pawn is on the left
-                        if (Helper::is_empty(allied_pawns, adj_files_right))
-                        { // File on the right has no pawn
-                            backwards_pawns++;
-                        }
+            // Backwards pawns & pawn chain:
+            int pos_captures = (pawn_captures_bb & allied_pawns).count();
+            if (pos_captures == 2)
+            {
+                backwards_pawns++;          // Backwards Pawn
+                pawn_chain += pos_captures; // Increment pawn chain bonus by 2
+            }
+            else if (pos_captures == 1)
+            {
+                pawn_chain++; // Increment pawn chain bonus
+                const Bitboard adj_files_left = BitOp::shift_left(file_bb);
+                const Bitboard adj_files_right = BitOp::shift_right(file_bb);
+                if (Helper::any(pawn_captures_bb, adj_files_left))
+                { // Allied pawn is on the left
+                    if (Helper::is_empty(allied_pawns, adj_files_right))
+                    { // File on the right has no pawn
+                        backwards_pawns++;
                     }
-                    else
-                    { // Allied pawn is on the right
-                        if (Helper::is_empty(allied_pawns, adj_files_left))
-                        { // File on the left has no pawn
-                            backwards_pawns++;
-                        }
+                }
+                else
+                { // Allied pawn is on the right
+                    if (Helper::is_empty(allied_pawns, adj_files_left))
+                    { // File on the left has no pawn
+                        backwards_pawns++;
                     }
                 }
             }
+        }
+
+        // Center Control:
+        center += (Masks::center & allied_pawns).count();
+    }
+
+    // The pawn terms that also depend on the other pieces: captures of pieces, checks and squares taken from the enemy king.
+    template <Color::underlying C>
+    void pawn_attacks(Bitboard allied_pawns, Bitboard enemy_pawns, int &valuable_pawn_captures, Bitboard enemy_king,
+                      Bitboard enemy_pieces)
+    {
+        if (!allied_pawns)
+            return;
 
-            // Center Control:
-            if (index == 3)
+        const Bitboard king_surroundings = enemy_king_ring<C>();
+        Bitboard remaining = allied_pawns;
+        while (remaining)
+        {
+            const Bitboard file_pawns = allied_pawns & Masks::file[remaining.lsb()];
+            remaining &= ~file_pawns;
+            Bitboard pawn_captures_bb = BitOp::shift_left(BitOp::shift_forward<C>(file_pawns)) | BitOp::shift_right(BitOp::shift_forward<C>(file_pawns));
+
+            // Captures:
+            // Shifts bitboard into capturable spots. First half returns bitboard of capturable squares for the each pawn, second half finds enemy_pieces that are not pawns.
+            valuable_pawn_captures += (pawn_captures_bb & (~enemy_pawns & enemy_pieces)).count();
+
+            // Checks and attacks on king:
+            if (Helper::any(pawn_captures_bb, enemy_king))
             {
-                center += (((file_bb | adj_files_right) & (rank_bb | BitOp::shift_up(rank_bb)) & (allied_pawns)).count());
+                add_king_pressure<C>(CHECKS, checks_constant);
             }
 
-            // Pawn piece location table:
-            Bitboard pawns_in_file = allied_pawns & file_bb;
-            while (pawns_in_file)
+            // Restricting King movement:
+            if (Helper::any(pawn_captures_bb, king_surroundings))
             {
-                int square_index = pawns_in_file.lsb(); // Get least significant bit index
-                pawn_positions.push_back(chess::Square(square_index));
-                pawn_position_score += (color == Color::WHITE) ? white_pawn_table[square_index] : -black_pawn_table[square_index];
-                (void)pawns_in_file.pop(); // Remove the least significant bit
+                add_king_pressure<C>(KING_RESTRICTION, king_restriction_bonus);
             }
         }
-        /* Should be accounted for in quiescence search.
-        // Encourages pawns to not be in a position where they can be captured
-        for (chess::Square sq : pawn_positions)
-        {
-            std::unordered_map<PieceType, int> pawn_is_attacked = Helper::isAttackedCount(data, sq, color == Color::WHITE ? Color::BLACK : Color::WHITE);
-            std::unordered_map<PieceType, int> pawn_support = Helper::isAttackedCount(data, sq, color);
-            int allied_attackers_total = Helper::total_attackers(pawn_support), enemy_attackers_total = Helper::total_attackers(pawn_is_attacked);
-            if (enemy_attackers_total && !allied_attackers_total)
-            { // Can be attacked and no defenders.
-                pawn_position_score -= (color == Color::WHITE ? 40 : -40);
-                continue;
-            }
-            else if (enemy_attackers_total >= allied_attackers_total)
-            {                                                                                 // In an exchange, opposing side will be up a piece.
-                pawn_position_score -= (enemy_attackers_total - allied_attackers_total) * 10; // Will be adjusted later.
-                continue;
-            };
-        }
-        */
     }
 
-    int pawn_score()
+    /// @brief The pawn terms that only depend on the pawns, white minus black. What the pawn hash caches.
+    static Score pawn_structure_score(Bitboard white_pawns, Bitboard black_pawns)
     {
         int white_doubled_pawns = 0, black_doubled_pawns = 0;
         int white_isolated_pawns = 0, black_isolated_pawns = 0;
         int white_passed_pawns = 0, black_passed_pawns = 0;
         int white_center = 0, black_center = 0;
-        int white_valuable_pawn_captures = 0, black_valuable_pawn_captures = 0;
         int white_backwards_pawns = 0, black_backwards_pawns = 0;
         int white_pawn_chain = 0, black_pawn_chain = 0;
 
         // White
-        Evaluation::pawn_structure(white_pawns, black_pawns, white_doubled_pawns, white_isolated_pawns,
-                                   white_passed_pawns, white_center, white_valuable_pawn_captures, white_backwards_pawns,
-                                   white_pawn_chain,
-                                   black_king, black_pieces, Color::WHITE);
+        Evaluation::pawn_structure<Color::WHITE>(white_pawns, black_pawns, white_doubled_pawns, white_isolated_pawns,
+                                                 white_passed_pawns, white_center, white_backwards_pawns, white_pawn_chain);
 
         // Black
-        Evaluation::pawn_structure(black_pawns, white_pawns, black_doubled_pawns, black_isolated_pawns,
-                                   black_passed_pawns, black_center, black_valuable_pawn_captures, black_backwards_pawns,
-                                   black_pawn_chain,
-                                   white_king, white_pieces, Color::BLACK);
+        Evaluation::pawn_structure<Color::BLACK>(black_pawns, white_pawns, black_doubled_pawns, black_isolated_pawns,
+                                                 black_passed_pawns, black_center, black_backwards_pawns, black_pawn_chain);
 
         /*
         // For debugging
@@ -543,14 +786,12 @@ public:
         std::cout << "White isolated pawns: " << white_isolated_pawns << '\n';
         std::cout << "White passed pawns: " << white_passed_pawns << '\n';
         std::cout << "White center pawns: " << white_center << '\n';
-        std::cout << "White valuable pawn captures: " << white_valuable_pawn_captures << '\n';
         std::cout << "White backwards pawns: " << white_backwards_pawns << '\n';
         std::cout << "White pawn chain: " << white_pawn_chain << '\n' << '\n';
         std::cout << "Black doubled pawns: " << black_doubled_pawns << '\n';
         std::cout << "Black isolated pawns: " << black_isolated_pawns << '\n';
         std::cout << "Black passed pawns: " << black_passed_pawns << '\n';
         std::cout << "Black center pawns: " << black_center << '\n';
-        std::cout << "Black valuable pawn captures: " << black_valuable_pawn_captures << '\n';
         std::cout << "Black backwards pawns: " << black_backwards_pawns << '\n';
         std::cout << "Black pawn chain: " << black_pawn_chain << '\n' << '\n';
         */
@@ -559,410 +800,335 @@ public:
                                    white_isolated_pawns, black_isolated_pawns,
                                    white_passed_pawns, black_passed_pawns,
                                    white_center, black_center,
-                                   white_valuable_pawn_captures, black_valuable_pawn_captures,
                                    white_backwards_pawns, black_backwards_pawns,
                                    white_pawn_chain, black_pawn_chain);
     }
 
+    // The structure terms come from this thread's pawn hash when the pawns have been seen before.
+    Score cached_pawn_structure()
+    {
+        // One thread_local lookup for the probe and the store.
+        PawnHashTable &table = pawn_hash_table;
+        Score structure = 0;
+        pawn_hash_hit = table.probe(white_pawns, black_pawns, structure);
+        if (!pawn_hash_hit)
+        {
+            structure = pawn_structure_score(white_pawns, black_pawns);
+            table.store(white_pawns, black_pawns, structure);
+        }
+#ifdef CHECK_INCREMENTAL_EVAL
+        else if (structure != pawn_structure_score(white_pawns, black_pawns))
+        {
+            std::cerr << "Pawn hash mismatch in position " << data.getFen() << '\n';
+            std::abort();
+        }
+#endif
+        return structure;
+    }
+
+    /// @param structure The pawn-only terms, see pawn_structure_score()
+    Score pawn_score(Score structure)
+    {
+        int white_valuable_pawn_captures = 0, black_valuable_pawn_captures = 0;
+        pawn_attacks<Color::WHITE>(white_pawns, black_pawns, white_valuable_pawn_captures, black_king, black_pieces);
+        pawn_attacks<Color::BLACK>(black_pawns, white_pawns, black_valuable_pawn_captures, white_king, white_pieces);
+
+        trace_term(VALUABLE_PAWN_CAPTURES, white_valuable_pawn_captures - black_valuable_pawn_captures);
+        return structure + (white_valuable_pawn_captures - black_valuable_pawn_captures) * valuable_pawn_captures_bonus;
+    }
+
     // Function whose only job is to sum up pawn_components.
-    int const sum_pawn_components(int &white_doubled_pawns, int &black_doubled_pawns,
-                                  int &white_isolated_pawns, int &black_isolated_pawns,
-                                  int &white_passed_pawns, int &black_passed_pawns,
-                                  int &white_center, int &black_center,
-                                  int &white_valuable_pawn_captures, int &black_valuable_pawn_captures,
-                                  int &white_backwards_pawns, int &black_backwards_pawns,
-                                  int &white_pawn_chain, int &black_pawn_chain)
+    static Score sum_pawn_components(int &white_doubled_pawns, int &black_doubled_pawns,
+                                   int &white_isolated_pawns, int &black_isolated_pawns,
+                                   int &white_passed_pawns, int &black_passed_pawns,
+                                   int &white_center, int &black_center,
+                                   int &white_backwards_pawns, int &black_backwards_pawns,
+                                   int &white_pawn_chain, int &black_pawn_chain)
     {
-        return -(white_doubled_pawns - black_doubled_pawns) * doubled_pawn_penalty - (white_isolated_pawns - black_isolated_pawns) * isolated_pawn_penalty + (white_passed_pawns - black_passed_pawns) * passed_pawn_bonus + (white_center - black_center) * pawn_center_control + (white_valuable_pawn_captures - black_valuable_pawn_captures) * valuable_pawn_captures_bonus - (white_backwards_pawns - black_backwards_pawns) * backwards_pawn_penalty + (white_pawn_chain - black_pawn_chain);
+        trace_term(DOUBLED_PAWNS, -(white_doubled_pawns - black_doubled_pawns));
+        trace_term(ISOLATED_PAWNS, -(white_isolated_pawns - black_isolated_pawns));
+        trace_term(PASSED_PAWNS, white_passed_pawns - black_passed_pawns);
+        trace_term(PAWN_CENTER, white_center - black_center);
+        trace_term(BACKWARDS_PAWNS, -(white_backwards_pawns - black_backwards_pawns));
+        trace_term(PAWN_CHAIN, white_pawn_chain - black_pawn_chain);
+        return -(white_doubled_pawns - black_doubled_pawns) * doubled_pawn_penalty - (white_isolated_pawns - black_isolated_pawns) * isolated_pawn_penalty + (white_passed_pawns - black_passed_pawns) * passed_pawn_bonus + (white_center - black_center) * pawn_center_control - (white_backwards_pawns - black_backwards_pawns) * backwards_pawn_penalty + (white_pawn_chain - black_pawn_chain) * pawn_chain_bonus;
     }
 
-    int bishop_score()
+    Score bishop_score()
     {
         int bishop_pair_bonus = 0;
         int white_bishop_mobility = 0, black_bishop_mobility = 0;
         int white_bishop_center = 0, black_bishop_center = 0;
-        bishop_eval(white_bishops, white_bishop_mobility, bishop_pair_bonus, white_bishop_center, black_king, Color::WHITE);
-        bishop_eval(black_bishops, black_bishop_mobility, bishop_pair_bonus, black_bishop_center, white_king, Color::BLACK);
+        bishop_eval<Color::WHITE>(white_bishops, white_bishop_mobility, bishop_pair_bonus, white_bishop_center, black_king);
+        bishop_eval<Color::BLACK>(black_bishops, black_bishop_mobility, bishop_pair_bonus, black_bishop_center, white_king);
 
-        return (white_bishop_mobility - black_bishop_mobility) * bishop_mobility_bonus + (white_bishop_center - black_bishop_center) * bishop_center_bonus + bishop_pair_bonus;
+        trace_term(BISHOP_MOBILITY, white_bishop_mobility - black_bishop_mobility);
+        trace_term(BISHOP_CENTER, white_bishop_center - black_bishop_center);
+        return (white_bishop_mobility - black_bishop_mobility) * bishop_mobility_bonus + (white_bishop_center - black_bishop_center) * bishop_center_bonus + bishop_pair_bonus * make_score(1, 1);
     }
 
-    void bishop_eval(Bitboard bishops, int &mobility, int &bishop_pair_bonus, int &bishop_center, Bitboard enemy_king, Color color)
+    template <Color::underlying C>
+    void bishop_eval(Bitboard bishops, int &mobility, int &bishop_pair_bonus, int &bishop_center, Bitboard enemy_king)
     {
         int bishops_count = bishops.count();
         if (bishops.count() == 0)
             return; // No bishops, no point evaluating.
-        std::vector<chess::Square> bishop_location;
-        bishop_location.reserve(bishops_count);
 
         // Bishop Pair
         if (bishops_count > 1)
         {
-            bishop_pair_bonus += (color == Color::WHITE ? 0.5 : -0.5);
-        }
-
-        // Locate Bishops by iterating through ranks
-        for (int sq_index = 0; sq_index < 64; ++sq_index)
-        {
-            chess::Square sq(sq_index);
-            if (bishops.check(sq_index))
-            {
-                bishop_location.push_back(sq);
-            }
-            if (color == Color::WHITE)
-            {
-                bishop_position_score += white_bishop_table[sq_index];
-            }
-            else
-            {
-                bishop_position_score -= black_bishop_table[sq_index];
-            }
+            bishop_pair_bonus += (C == Color::WHITE ? 0.5 : -0.5);
         }
 
         // Mobility bonus for taking a lot of squares.
-        for (int i = 0; i < bishops_count; ++i)
+        const Bitboard king_surroundings = enemy_king_ring<C>();
+        Bitboard remaining = bishops;
+        while (remaining)
         {
-            Bitboard bishop_attacks = chess::attacks::bishop(bishop_location[i], all_pieces);
+            Bitboard bishop_attacks = attacks->piece_attacks[remaining.pop()];
             mobility += bishop_attacks.count();
 
             // Checks:
             if (Helper::any(bishop_attacks, enemy_king))
             {
-                pins_and_checks_score += (color == Color::WHITE ? checks_constant : -checks_constant);
+                add_king_pressure<C>(CHECKS, checks_constant);
             }
 
             // Restricting king movement
-            if (Helper::any(bishop_attacks, BitOp::get_surrounding_bits(enemy_king)))
+            if (Helper::any(bishop_attacks, king_surroundings))
             {
-                pins_and_checks_score += (color == Color::WHITE ? king_restriction_bonus : -king_restriction_bonus);
+                add_king_pressure<C>(KING_RESTRICTION, king_restriction_bonus);
             }
         }
 
         // Bonus for Bishops being in the center.
-        Bitboard file_bb(File::FILE_D);
-        Bitboard rank_bb(Rank::RANK_4);
-        bishop_center += (((file_bb | BitOp::shift_right(file_bb)) & (rank_bb | BitOp::shift_up(rank_bb)) & (bishops)).count());
+        bishop_center += (Masks::center & bishops).count();
 
         // Fianchetto Bonus (Not yet implemented)
-
-        /*
-        // Encourages Bishops to not be in a position where they can be captured
-        for (chess::Square sq : bishop_location)
-        {
-            std::unordered_map<PieceType, int> bishop_is_attacked = Helper::isAttackedCount(data, sq, color == Color::WHITE ? Color::BLACK : Color::WHITE);
-            std::unordered_map<PieceType, int> bishop_support = Helper::isAttackedCount(data, sq, color);
-            int allied_attackers_total = Helper::total_attackers(bishop_support), enemy_attackers_total = Helper::total_attackers(bishop_is_attacked);
-            if (bishop_is_attacked[PieceType::PAWN])
-            {
-                // Bishop can be taken by a pawn, so it is essentially lost
-                bishop_position_score -= (color == Color::WHITE ? 75 : -75); // Will be adjusted
-                continue;
-            }
-            if (enemy_attackers_total && !allied_attackers_total)
-            {
-                bishop_position_score -= (color == Color::WHITE ? 75 : -75);
-                continue;
-            }
-            else if (enemy_attackers_total >= allied_attackers_total)
-            {
-                bishop_position_score -= (enemy_attackers_total - allied_attackers_total) * 15; // Will be adjusted later;
-                continue;
-            }
-        }
-        */
     }
 
-    int knight_score()
+    Score knight_score()
     {
         int white_knight_mobility = 0, black_knight_mobility = 0;
-        knight_eval(white_knights, white_knight_mobility, black_king, white_pieces, Color::WHITE);
-        knight_eval(black_knights, black_knight_mobility, white_king, black_pieces, Color::BLACK);
+        knight_eval<Color::WHITE>(white_knights, white_knight_mobility, black_king, white_pieces);
+        knight_eval<Color::BLACK>(black_knights, black_knight_mobility, white_king, black_pieces);
+        trace_term(KNIGHT_MOBILITY, white_knight_mobility - black_knight_mobility);
         return (white_knight_mobility - black_knight_mobility) * knight_mobility_bonus;
     }
 
-    void knight_eval(Bitboard knights, int &knight_mobility, Bitboard enemy_king, Bitboard allied_pieces, Color color)
+    template <Color::underlying C>
+    void knight_eval(Bitboard knights, int &knight_mobility, Bitboard enemy_king, Bitboard allied_pieces)
     {
-        int knights_count = knights.count();
-        if (knights_count == 0)
+        if (!knights)
             return; // No knights, no point evaluating.
-        std::vector<chess::Square> knight_positions;
-        knight_positions.reserve(knights_count);
 
-        for (int index = 0; index < 8; ++index)
+        const Bitboard king_surroundings = enemy_king_ring<C>();
+        Bitboard remaining = knights;
+        while (remaining)
         {
-            File file(static_cast<File::underlying>(index));
-            Bitboard file_bb(file);
-            Rank rank(static_cast<Rank::underlying>(index));
-            Bitboard rank_bb(rank);
-
-            // Locating knights
-            Bitboard knights_in_file = knights & file_bb;
-            while (knights_in_file)
-            {
-                int square_index = knights_in_file.lsb(); // Get least significant bit index
-                knight_positions.push_back(chess::Square(square_index));
-                // std::cout << color << " Knight Square index: " << std::to_string(square_index) << '\n';
-                knight_position_score += (color == Color::WHITE) ? white_knight_table[square_index] : -black_knight_table[square_index];
-                (void)knights_in_file.pop(); // Remove least significant bit
-            }
-        }
-
-        for (int i = 0; i < knights_count; i++)
-        {
-            Bitboard knight_attacks = chess::attacks::knight(knight_positions[i]);
+            Bitboard knight_attacks = attacks->piece_attacks[remaining.pop()];
             // Checks
             if (Helper::any(knight_attacks, enemy_king))
             {
-                pins_and_checks_score += (color == Color::WHITE ? checks_constant : -checks_constant);
+                add_king_pressure<C>(CHECKS, checks_constant);
             }
 
             // Restricting king movement
-            if (Helper::any(knight_attacks, BitOp::get_surrounding_bits(enemy_king)))
+            if (Helper::any(knight_attacks, king_surroundings))
             {
-                pins_and_checks_score += (color == Color::WHITE ? king_restriction_bonus : -king_restriction_bonus);
+                add_king_pressure<C>(KING_RESTRICTION, king_restriction_bonus);
             }
 
             // Knight Movement bonus:
             knight_mobility += (knight_attacks & ~allied_pieces).count();
         }
-
-        /*
-        // Encourages Knights to not be in a position where they can be captured
-        for (chess::Square sq : knight_positions)
-        {
-            std::unordered_map<PieceType, int> knight_is_attacked = Helper::isAttackedCount(data, sq, color == Color::WHITE ? Color::BLACK : Color::WHITE);
-            std::unordered_map<PieceType, int> knight_support = Helper::isAttackedCount(data, sq, color);
-            int allied_attackers_total = Helper::total_attackers(knight_support), enemy_attackers_total = Helper::total_attackers(knight_is_attacked);
-            if (enemy_attackers_total && !allied_attackers_total)
-            {
-                knight_position_score -= (color == Color::WHITE ? 60 : -60);
-                continue;
-            }
-            else if (knight_is_attacked[PieceType::PAWN])
-            {
-                // Knight can be taken by a pawn, so it is essentially lost
-                knight_position_score -= (color == Color::WHITE ? 50 : -50); // Will be adjusted
-                continue;
-            }
-            else if (enemy_attackers_total >= allied_attackers_total)
-            {
-                knight_position_score -= (enemy_attackers_total - allied_attackers_total) * 15; // Will be adjusted later.
-                continue;
-            }
-        }
-        */
     }
 
-    int rook_score()
+    Score rook_score()
     {
         int white_rook_open_file = 0, black_rook_open_file = 0;
         int white_stacked_rook = 0, black_stacked_rook = 0;
         int white_rook_mobility = 0, black_rook_mobility = 0;
 
         // White
-        rook_eval(white_rooks, white_rook_open_file, white_stacked_rook, white_rook_mobility, black_king, Color::WHITE);
+        rook_eval<Color::WHITE>(white_rooks, white_rook_open_file, white_stacked_rook, white_rook_mobility, black_king);
 
         // Black
-        rook_eval(black_rooks, black_rook_open_file, black_stacked_rook, black_rook_mobility, white_king, Color::BLACK);
+        rook_eval<Color::BLACK>(black_rooks, black_rook_open_file, black_stacked_rook, black_rook_mobility, white_king);
+        trace_term(ROOK_OPEN_FILE, white_rook_open_file - black_rook_open_file);
+        trace_term(STACKED_ROOKS, white_stacked_rook - black_stacked_rook);
+        trace_term(ROOK_MOBILITY, white_rook_mobility - black_rook_mobility);
         return (white_rook_open_file - black_rook_open_file) * rook_open_file_bonus + (white_stacked_rook - black_stacked_rook) * stacked_rooks_bonus + (white_rook_mobility - black_rook_mobility) * rook_mobility_bonus;
     }
 
-    void rook_eval(Bitboard rooks, int &rook_open_file, int &stacked_rook, int &rook_mobility, Bitboard enemy_king, Color color)
+    template <Color::underlying C>
+    void rook_eval(Bitboard rooks, int &rook_open_file, int &stacked_rook, int &rook_mobility, Bitboard enemy_king)
     {
-        int rooks_count = rooks.count();
-        if (rooks_count == 0)
+        if (!rooks)
             return; // No rooks, no point evaluating.
-        std::vector<chess::Square> rook_location;
-        rook_location.reserve(rooks_count);
 
-        for (int index = 0; index < 8; ++index)
+        // Open lines: every file and every rank without a black pawn on it.
+        rook_open_file += 16 - BitOp::occupied_files(black_pawns) - BitOp::occupied_ranks(black_pawns);
+
+        // Stacked rooks: each file and each rank holding two rooks or more counts once.
+        Bitboard stacked_files, stacked_ranks;
+        const Bitboard king_surroundings = enemy_king_ring<C>();
+        Bitboard remaining = rooks;
+        while (remaining)
         {
-            File file(static_cast<File::underlying>(index));
-            Bitboard file_bb(file);
-            Rank rank(static_cast<Rank::underlying>(index));
-            Bitboard rank_bb(rank);
-
-            // Check if rooks are doubled
-            Bitboard rooks_in_file = rooks & file_bb;
-            if (rooks_in_file.count() >= 2)
-                stacked_rook++;
-            Bitboard rooks_in_rank = rooks & rank_bb;
-            if (rooks_in_rank.count() >= 2)
-                stacked_rook++;
-
-            // Locate the rook:
-            while (rooks_in_file)
+            const int square = remaining.pop();
+            if ((remaining & Masks::file[square]) && !(stacked_files & Masks::file[square]))
             {
-                int square_index = rooks_in_file.lsb(); // Get lsb
-                rook_location.push_back(chess::Square(square_index));
-                // std::cout << color << " Rook Square index: " << std::to_string(square_index) << '\n';
-                rook_position_score += (color == Color::WHITE ? white_rook_table[square_index] : -black_rook_table[square_index]);
-                (void)rooks_in_file.pop(); // Remove lsb
+                ++stacked_rook;
+                stacked_files |= Masks::file[square];
             }
+            if ((remaining & Masks::rank[square]) && !(stacked_ranks & Masks::rank[square]))
+            {
+                ++stacked_rook;
+                stacked_ranks |= Masks::rank[square];
+            }
+            Bitboard rook_attacks = attacks->piece_attacks[square];
 
-            // Determining if file is open:
-            bool file_is_open = !(file_bb & black_pawns);
-            if (file_is_open)
-                ++rook_open_file;
-
-            // Determining if rank is open:
-            bool rank_is_open = !(rank_bb & black_pawns);
-            if (rank_is_open)
-                ++rook_open_file;
-        }
-
-        // Determine how mobile rooks are:
-        for (int i = 0; i < rooks_count; ++i)
-        {
-            rook_mobility += (chess::attacks::rook(rook_location[i], all_pieces)).count();
-        }
+            // Determine how mobile rooks are:
+            rook_mobility += rook_attacks.count();
 
-        for (int i = 0; i < rook_location.size(); i++)
-        {
-            Bitboard rook_attacks = chess::attacks::rook(rook_location[i], all_pieces);
             // Checks
             if (Helper::any(rook_attacks, enemy_king))
             {
-                pins_and_checks_score += (color == Color::WHITE ? checks_constant : -checks_constant);
+                add_king_pressure<C>(CHECKS, checks_constant);
             }
 
             // Restricting king movement
-            if (Helper::any(rook_attacks, BitOp::get_surrounding_bits(enemy_king)))
+            if (Helper::any(rook_attacks, king_surroundings))
             {
-                pins_and_checks_score += (color == Color::WHITE ? king_restriction_bonus : -king_restriction_bonus);
+                add_king_pressure<C>(KING_RESTRICTION, king_restriction_bonus);
             }
         }
-
-        /*
-        // Encourages rooks to not be in a position where they can be captured
-        for (chess::Square sq : rook_location)
-        {
-            std::unordered_map<PieceType, int> rook_is_attacked = Helper::isAttackedCount(data, sq, color == Color::WHITE ? Color::BLACK : Color::WHITE);
-            std::unordered_map<PieceType, int> rook_support = Helper::isAttackedCount(data, sq, color);
-            int allied_attackers_total = Helper::total_attackers(rook_support), enemy_attackers_total = Helper::total_attackers(rook_is_attacked);
-            if (enemy_attackers_total && !allied_attackers_total)
-            {
-                rook_position_score -= (color == Color::WHITE ? 125 : -125); // Will be adjusted
-                continue;
-            }
-            else if (rook_is_attacked[PieceType::PAWN])
-            {                                                                // Pawn can take rook. Almost always a bad exchange.
-                rook_position_score -= (color == Color::WHITE ? 125 : -125); // Will be adjusted
-                continue;
-            }
-            else if (rook_is_attacked[PieceType::KNIGHT] || rook_is_attacked[PieceType::BISHOP])
-            {
-                if (allied_attackers_total < enemy_attackers_total)
-                { // Opposing side will win exchange, leading to loss of material
-                    rook_position_score -= (color == Color::WHITE ? 50 : -50);
-                    continue;
-                }
-            }
-            else if (enemy_attackers_total >= allied_attackers_total)
-            {
-                rook_position_score -= (allied_attackers_total - enemy_attackers_total) * 15; // Will be adjusted later.
-                continue;
-            }
-        }
-        */
     }
 
-    int queen_score()
+    Score queen_score()
     {
         // White
-        queen_eval(white_queens, black_king, black_pieces, Color::WHITE);
+        queen_eval<Color::WHITE>(white_queens, black_king);
 
         // Black
-        queen_eval(black_queens, white_king, white_pieces, Color::BLACK);
+        queen_eval<Color::BLACK>(black_queens, white_king);
         return 0;
     }
 
-    void queen_eval(Bitboard queens, Bitboard enemy_king, Bitboard enemy_pieces, Color color)
+    template <Color::underlying C>
+    void queen_eval(Bitboard queens, Bitboard enemy_king)
     {
-        int queens_count = queens.count();
-        int enemy_pieces_count = enemy_pieces.count();
-        if (queens_count == 0)
+        if (!queens)
             return; // No queens, no point evaluating.
-        std::vector<chess::Square> queen_location;
-        queen_location.reserve(queens_count);
 
-        for (int index = 0; index < 8; ++index)
+        const Bitboard king_surroundings = enemy_king_ring<C>();
+        Bitboard remaining = queens;
+        while (remaining)
         {
-            File file(static_cast<File::underlying>(index));
-            Bitboard file_bb(file);
-            Rank rank(static_cast<Rank::underlying>(index));
-            Bitboard rank_bb(rank);
+            Bitboard queen_attacks = attacks->piece_attacks[remaining.pop()];
 
-            Bitboard queens_in_file = queens & file_bb;
-            while (queens_in_file)
+            // Checks, worth more as the board empties
+            if (Helper::any(queen_attacks, enemy_king))
             {
-                int square_index = queens_in_file.lsb(); // Get least significant bit index
-                queen_location.push_back(chess::Square(square_index));
-                if (enemy_pieces_count > 10)
-                {
-                    queen_position_score += (color == Color::WHITE ? early_white_queen_table[square_index] : -early_black_queen_table[square_index]);
-                }
-                else
-                {
-                    queen_position_score += (color == Color::WHITE ? late_white_queen_table[square_index] : -late_black_queen_table[square_index]);
-                }
-                (void)queens_in_file.pop(); // Remove the least significant bit
-            }
-        }
-        // std::cout << color << " Queen Square index: " << std::to_string(square_index) << '\n';
-        for (int i = 0; i < queen_location.size(); i++)
-        {
-            Bitboard queen_attacks = chess::attacks::queen(queen_location[i], all_pieces);
-            if (enemy_pieces_count < 11)
-            {
-                // Checks
-                if (Helper::any(queen_attacks, enemy_king))
-                {
-                    pins_and_checks_score += (color == Color::WHITE ? checks_constant : -checks_constant);
-                }
+                add_king_pressure<C>(QUEEN_CHECKS, queen_check_bonus);
             }
 
             // Restricting king movement
-            if (Helper::any(queen_attacks, BitOp::get_surrounding_bits(enemy_king)))
+            if (Helper::any(queen_attacks, king_surroundings))
             {
-                pins_and_checks_score += (color == Color::WHITE ? king_restriction_bonus : -king_restriction_bonus);
+                add_king_pressure<C>(KING_RESTRICTION, king_restriction_bonus);
             }
         }
     }
 
-    int king_score()
+    Score king_score()
     {
         // White
-        king_eval(Color::WHITE);
+        king_eval<Color::WHITE>();
 
         // Black
-        king_eval(Color::BLACK);
+        king_eval<Color::BLACK>();
         return 0;
     }
 
-    void king_eval(Color color)
+    template <Color::underlying C>
+    void king_eval()
     {
-        chess::Square king_square = data.kingSq(color);
-        int king_attackers = Helper::total_attackers(Helper::isAttackedCount(data, king_square, color == Color::WHITE ? Color::BLACK : Color::WHITE));
+        chess::Square king_square = data.kingSq(C);
+        int king_attackers = attacks->attackers(king_square, ~Color(C)).total();
         if (king_attackers >= 2)
         {
-            king_position_score -= (color == Color::WHITE ? 300 : -300); // Will be adjusted. Tries to prevent double checks.
+            constexpr int sign = C == Color::WHITE ? 1 : -1;
+            king_position_score -= sign * king_double_attack_penalty; // Will be adjusted. Tries to prevent double checks.
+            trace_term(KING_DOUBLE_ATTACK, -sign);
+        }
+    }
+
+    Score sum_pos() const
+    {
+        return accumulator.psqt + king_position_score;
+    }
+
+    /*
+    Heuristic score only, white positive. Does not look for mate or draws, so the caller must
+    already know the game is not over. The search knows that from the move list it generates
+    anyway; everyone else should use static_eval(). */
+    int evaluate()
+    {
+        return evaluate_with_pawn_structure(cached_pawn_structure());
+    }
+
+    /// @brief evaluate(), with the pawn structure terms already computed by the caller (see evaluate_batch).
+    int evaluate_with_pawn_structure(Score pawn_structure)
+    {
+#ifdef CHECK_INCREMENTAL_EVAL
+        // Test mode: the incrementally kept sums must match a from-scratch recount.
+        if (!(accumulator == EvalAccumulator::from_board(data)))
+        {
+            std::cerr << "Incremental evaluation mismatch in position " << data.getFen() << '\n';
+            std::abort();
         }
+#endif
+        // The maps are most of an Evaluation's size, so they live only as long as the terms that read them.
+        const Helper::AttackMaps maps = Helper::AttackMaps::compute(data);
+        attacks = &maps;
+        Score temp = pawn_score(pawn_structure) + bishop_score() + knight_score() + rook_score() + queen_score() + king_score();
+        attacks = nullptr;
+        Score total = temp + sum_pos() + pins_and_checks_score;
+        if constexpr (EVAL_TRACE_ENABLED)
+        {
+            eval_trace.total = total;
+            eval_trace.phase = accumulator.phase;
+        }
+        return taper(total, accumulator.phase);
     }
 
-    int const sum_pos()
+    /*
+    evaluate() for the search, which only needs the exact score inside its window [lower, upper]
+    (white's point of view, like the result). Material, piece-square tables and the pawn structure,
+    usually a pawn hash hit, come first. If that cheap part is more than LAZY_EVAL_MARGIN outside
+    the window, the attack maps and everything built on them (pawn attacks, mobility, rooks, king
+    safety, pins and checks) are skipped: they cannot bring it back. The cheap part moved by the
+    margin towards the window is returned then, which is still on the same side of the window.
+    @param lazy Set to true if the expensive terms were skipped */
+    int evaluate_lazy(int lower, int upper, bool &lazy)
     {
-        return pawn_position_score + bishop_position_score + knight_position_score + rook_position_score + queen_position_score + king_position_score;
+        const Score pawn_structure = cached_pawn_structure();
+        const int cheap = taper(accumulator.psqt + pawn_structure, accumulator.phase);
+        lazy = cheap - LAZY_EVAL_MARGIN >= upper || cheap + LAZY_EVAL_MARGIN <= lower;
+        if (!lazy)
+            return evaluate_with_pawn_structure(pawn_structure);
+        return cheap >= upper ? cheap - LAZY_EVAL_MARGIN : cheap + LAZY_EVAL_MARGIN;
     }
 
+    // Full evaluation including game over detection. Costs a legal move generation.
     int static_eval()
     {
-        int temp;
         switch (data.isGameOver().second)
         {
         case chess::GameResult::NONE:
-            temp = naive_material_balance() + pawn_score() + bishop_score() + knight_score() + rook_score() + queen_score() + king_score();
-            return temp + sum_pos() + pins_and_checks_score;
+            return evaluate();
         case chess::GameResult::WIN:
             return side == Color::BLACK ? -99999 : 99999;
         case chess::GameResult::LOSE:
@@ -973,8 +1139,183 @@ public:
             return 0;
         }
     }
+
+    /// @brief True if the last evaluation found its pawn structure in the pawn hash.
+    bool used_pawn_hash() const { return pawn_hash_hit; }
+};
+
+/*
+The evaluations the search can use. CLASSICAL is Evaluation, the hand written terms above.
+NNUE is the network in Nnue::network, which boards feed with an Nnue::Accumulator while it
+is selected. Only switch while no search is running: a board keeps an accumulator only if it
+was set up while NNUE was selected. */
+enum class EvalBackend
+{
+    CLASSICAL,
+    NNUE
+};
+
+inline EvalBackend eval_backend = EvalBackend::CLASSICAL;
+
+/// @brief Selects the backend the search evaluates with.
+/// @return false, leaving the backend alone, if NNUE is asked for without a network loaded
+inline bool select_eval_backend(EvalBackend backend)
+{
+    if (backend == EvalBackend::NNUE && !Nnue::network.is_loaded())
+        return false;
+    eval_backend = backend;
+    return true;
+}
+
+/*
+A board that keeps an EvalAccumulator in step with its pieces, and with the NNUE backend
+selected an Nnue::Accumulator too. chess::Board routes every piece change in
+makeMove/unmakeMove through the virtual placePiece/removePiece, so overriding those is
+enough to keep the sums current. Evaluating then only pays for the non-linear terms. */
+class EvalBoard : public chess::Board
+{
+public:
+    explicit EvalBoard(std::string_view fen = chess::constants::STARTPOS) : chess::Board(fen)
+    {
+        refresh();
+    }
+
+    explicit EvalBoard(const chess::Board &board) : chess::Board(board)
+    {
+        refresh();
+    }
+
+    // The base class still sets up the start position first; reuse one board with load() for bulk work.
+    explicit EvalBoard(const PositionRecord &record)
+    {
+        load(record);
+    }
+
+    void setFen(std::string_view fen) override
+    {
+        chess::Board::setFen(fen);
+        refresh();
+    }
+
+    /// @brief Sets up the position stored in a record, without going through a FEN string.
+    void load(const PositionRecord &record)
+    {
+        occ_bb_.fill(0ULL);
+        pieces_bb_.fill(0ULL);
+        board_.fill(chess::Piece::NONE);
+        prev_states_.clear();
+        cr_.clear();
+        chess960_ = false;
+
+        chess::Bitboard occupied(record.occupancy);
+        for (int index = 0; occupied; ++index)
+            chess::Board::placePiece(record.piece(index), occupied.pop());
+
+        using Side = chess::Board::CastlingRights::Side;
+        if (record.flags & PositionRecord::WHITE_KING_SIDE)
+            cr_.setCastlingRight(chess::Color::WHITE, Side::KING_SIDE, chess::File::FILE_H);
+        if (record.flags & PositionRecord::WHITE_QUEEN_SIDE)
+            cr_.setCastlingRight(chess::Color::WHITE, Side::QUEEN_SIDE, chess::File::FILE_A);
+        if (record.flags & PositionRecord::BLACK_KING_SIDE)
+            cr_.setCastlingRight(chess::Color::BLACK, Side::KING_SIDE, chess::File::FILE_H);
+        if (record.flags & PositionRecord::BLACK_QUEEN_SIDE)
+            cr_.setCastlingRight(chess::Color::BLACK, Side::QUEEN_SIDE, chess::File::FILE_A);
+
+        const bool black = record.flags & PositionRecord::BLACK_TO_MOVE;
+        stm_ = black ? chess::Color::BLACK : chess::Color::WHITE;
+        ep_sq_ = record.ep_square < 64 ? chess::Square(record.ep_square) : chess::Square(chess::Square::underlying::NO_SQ);
+        hfm_ = record.halfmove_clock;
+        plies_ = static_cast<std::uint16_t>(std::max<int>(record.fullmove_number, 1) * 2 - 2 + black);
+        key_ = zobrist();
+        refresh();
+    }
+
+    const EvalAccumulator &accumulator() const { return acc; }
+
+    const Nnue::Accumulator &nnue_accumulator() const { return nnue; }
+
+    /// @brief The NNUE backend's score, from the side to move's point of view. Only with NNUE selected.
+    int nnue_evaluate() const
+    {
+#ifdef CHECK_INCREMENTAL_EVAL
+        Nnue::Accumulator recount;
+        recount.refresh(*this);
+        if (!(recount == nnue))
+        {
+            std::cerr << "Incremental NNUE accumulator mismatch in position " << getFen() << '\n';
+            std::abort();
+        }
+#endif
+        return Nnue::evaluate(nnue, sideToMove());
+    }
+
+    /// @brief Makes room for this many more moves in the move history, so making them does not allocate.
+    void reserve_history(std::size_t plies) { prev_states_.reserve(prev_states_.size() + plies); }
+
+protected:
+    void placePiece(chess::Piece piece, chess::Square sq) override
+    {
+        chess::Board::placePiece(piece, sq);
+        acc.add(piece, sq);
+        if (eval_backend == EvalBackend::NNUE)
+            nnue.add(piece, sq);
+    }
+
+    void removePiece(chess::Piece piece, chess::Square sq) override
+    {
+        chess::Board::removePiece(piece, sq);
+        acc.remove(piece, sq);
+        if (eval_backend == EvalBackend::NNUE)
+            nnue.remove(piece, sq);
+    }
+
+private:
+    EvalAccumulator acc;
+    Nnue::Accumulator nnue;
+
+    // Recount from scratch. Needed after the base class rebuilt the board without our hooks.
+    void refresh()
+    {
+        acc = EvalAccumulator::from_board(*this);
+        if (eval_backend == EvalBackend::NNUE)
+            nnue.refresh(*this);
+    }
 };
 
+Evaluation::Evaluation(const EvalBoard &data, Color side) : Evaluation(data, side, data.accumulator()) {}
+
+// Tables are static and the attack maps are on the stack, so an Evaluation is just a board
+// reference, the bitboards it reads and a few sums.
+static_assert(sizeof(Evaluation) <= 256, "Evaluation should stay cheap to construct");
+
+void EvalAccumulator::update(chess::Piece piece, chess::Square sq, int sign)
+{
+    psqt += sign * Evaluation::psqt[piece][sq.index()];
+    phase += sign * Evaluation::phase_weights[static_cast<int>(piece.type())];
+}
+
+void EvalAccumulator::add(chess::Piece piece, chess::Square sq)
+{
+    update(piece, sq, 1);
+}
+
+void EvalAccumulator::remove(chess::Piece piece, chess::Square sq)
+{
+    update(piece, sq, -1);
+}
+
+EvalAccumulator EvalAccumulator::from_board(const chess::Board &board)
+{
+    EvalAccumulator acc;
+    Bitboard occupied = board.occ();
+    while (occupied)
+    {
+        chess::Square sq = occupied.pop();
+        acc.add(board.at(sq), sq);
+    }
+    return acc;
+}
+
 /*
 int main() {
     // chess::Board board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
@@ -0,0 +1,28 @@
+#ifndef EVAL_WEIGHTS_HPP
+#define EVAL_WEIGHTS_HPP
+
+#include "Score.hpp"
+
+// Evaluation weights as (middlegame, endgame) pairs. tune.cpp writes this file; these are the hand-set starting values.
+namespace EvalWeights
+{
+    constexpr Score doubled_pawn_penalty = make_score(20, 20);
+    constexpr Score isolated_pawn_penalty = make_score(20, 20);
+    constexpr Score passed_pawn_bonus = make_score(50, 50);
+    constexpr Score pawn_center_control = make_score(100, 100);
+    constexpr Score valuable_pawn_captures_bonus = make_score(5, 5);
+    constexpr Score backwards_pawn_penalty = make_score(20, 20);
+    constexpr Score pawn_chain_bonus = make_score(1, 1);
+    constexpr Score bishop_mobility_bonus = make_score(5, 5);
+    constexpr Score bishop_center_bonus = make_score(40, 40);
+    constexpr Score rook_open_file_bonus = make_score(35, 35);
+    constexpr Score stacked_rooks_bonus = make_score(25, 25);
+    constexpr Score rook_mobility_bonus = make_score(5, 5);
+    constexpr Score knight_mobility_bonus = make_score(25, 25);
+    constexpr Score king_restriction_bonus = make_score(8, 8);
+    constexpr Score checks_constant = make_score(25, 25);
+    constexpr Score queen_check_bonus = make_score(0, 25);
+    constexpr Score king_double_attack_penalty = make_score(300, 300);
+}
+
+#endif
@@ -0,0 +1,350 @@
+#ifndef GAME_LOG_HPP
+#define GAME_LOG_HPP
+
+#include "chess.hpp"
+#include "Eval.hpp"
+#include "PositionRecord.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How much a GameLog writes.
+enum class LogLevel
+{
+    OFF,   // Nothing, the file is not even opened
+    MOVES, // Every move and the position after it
+    EVAL   // Also the static evaluation after every move
+};
+
+// How a GameLog writes it, picked from the file name by GameLog::format_for().
+enum class LogFormat
+{
+    TEXT,  // The board diagram after every move, for watching a game in an editor (board.txt)
+    JSONL, // One JSON object per move
+    PGN    // One PGN game per game, written when it ends
+};
+
+/*
+Bounded queue of many producers and one consumer, without locks (Vyukov's bounded queue).
+Each slot has a sequence number saying whose turn it is: a producer claims a slot by moving
+head on with a compare-exchange and publishes the value by bumping the slot's sequence, so
+producers only ever contend on head and never wait for each other to finish writing. */
+template <typename T, std::size_t CAPACITY>
+class RingBuffer
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "The capacity is a power of two");
+
+public:
+    RingBuffer()
+    {
+        for (std::size_t i = 0; i < CAPACITY; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /// @brief Appends a value. Returns false, leaving the queue alone, if it is full.
+    bool try_push(const T &value)
+    {
+        std::size_t position = head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Slot &slot = slots[position & (CAPACITY - 1)];
+            const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t lag = static_cast<std::ptrdiff_t>(sequence - position);
+            if (lag == 0)
+            {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+                return false; // The consumer has not freed this slot yet
+            else
+                position = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Takes the oldest value. Only one thread may pop.
+    bool try_pop(T &value)
+    {
+        const std::size_t position = tail;
+        Slot &slot = slots[position & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+            return false;
+        value = slot.value;
+        slot.sequence.store(position + CAPACITY, std::memory_order_release);
+        tail = position + 1;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::array<Slot, CAPACITY> slots;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::size_t tail = 0; // The consumer's alone
+};
+
+/*
+Game logging off the game threads. A game thread only copies a fixed-size record into a
+ring buffer; a background thread takes the records out in batches, turns them into text
+and writes the batch with one call, flushing whenever it has caught up. So games never wait
+on the disk, and a file being watched still shows each move as soon as it is played.
+
+Everything that costs anything is done by the writer: rebuilding the position from the
+record, the SAN, the FEN, the board diagram and, at LogLevel::EVAL, the evaluation. At
+LogLevel::MOVES nothing is evaluated at all. Any number of games may be logged at once
+from any threads; the records of one game stay in the order they were logged. */
+class GameLog
+{
+public:
+    GameLog(const std::string &path, LogLevel level, LogFormat format = LogFormat::TEXT) : level(level), format(format)
+    {
+        if (level == LogLevel::OFF)
+            return;
+        output.open(path);
+        if (output)
+            writer = std::thread(&GameLog::write_records, this);
+    }
+
+    /// @brief Writes out every record still queued, then stops the writer.
+    ~GameLog()
+    {
+        if (!writer.joinable())
+            return;
+        closing.store(true, std::memory_order_release);
+        published.fetch_add(1, std::memory_order_release);
+        published.notify_one();
+        writer.join();
+    }
+
+    GameLog(const GameLog &) = delete;
+    GameLog &operator=(const GameLog &) = delete;
+
+    /// @brief The format a file name asks for: .jsonl and .pgn, anything else is text.
+    static LogFormat format_for(const std::string &path)
+    {
+        return path.ends_with(".jsonl") ? LogFormat::JSONL : path.ends_with(".pgn") ? LogFormat::PGN : LogFormat::TEXT;
+    }
+
+    /// @brief True if the log is being written. False when the level is OFF or the file cannot be opened.
+    bool is_open() const { return writer.joinable(); }
+
+    /// @brief Starts a game from a position.
+    /// @return The game's number, for its moves and its end
+    std::uint32_t start_game(const chess::Board &board)
+    {
+        const std::uint32_t game = next_game.fetch_add(1, std::memory_order_relaxed) + 1;
+        push({Kind::START, game, chess::Move::NO_MOVE, PositionRecord::from_board(board)});
+        return game;
+    }
+
+    /// @brief Logs a move, given the position before it is played.
+    void log_move(std::uint32_t game, const chess::Board &board, chess::Move move)
+    {
+        push({Kind::MOVE, game, move, PositionRecord::from_board(board)});
+    }
+
+    /// @brief Ends a game. Its result is taken from the final position: a loss for a mated side
+    /// to move, a draw for any other finished game, unfinished ("*") otherwise.
+    void end_game(std::uint32_t game, const chess::Board &board)
+    {
+        PositionRecord position = PositionRecord::from_board(board);
+        const auto [reason, result] = board.isGameOver();
+        if (result == chess::GameResult::LOSE)
+            position.result = board.sideToMove() == chess::Color::WHITE ? 0 : 2;
+        else if (reason != chess::GameResultReason::NONE)
+            position.result = 1;
+        push({Kind::END, game, chess::Move::NO_MOVE, position});
+    }
+
+private:
+    enum class Kind : std::uint8_t
+    {
+        START,
+        MOVE,
+        END
+    };
+
+    struct Record
+    {
+        Kind kind = Kind::MOVE;
+        std::uint32_t game = 0;
+        chess::Move move = chess::Move::NO_MOVE;
+        PositionRecord position; // The start position, the position before the move, or the final position
+    };
+
+    // A game between its start and end, for PGN.
+    struct PgnGame
+    {
+        std::string fen;
+        int first_move = 1;
+        bool white_first = true;
+        std::vector<std::string> moves; // SAN, with the evaluation as a comment at LogLevel::EVAL
+    };
+
+    static constexpr std::size_t CAPACITY = 4096;
+    static constexpr std::size_t BATCH_BYTES = 1 << 16; // Written at once when a batch grows this large
+
+    const LogLevel level;
+    const LogFormat format;
+    std::ofstream output;
+    RingBuffer<Record, CAPACITY> records;
+    std::atomic<std::uint32_t> published{0}; // Bumped after every push, for the writer to wait on
+    std::atomic<bool> closing{false};
+    std::atomic<std::uint32_t> next_game{0};
+    std::thread writer;
+
+    // Only a full buffer makes a game thread wait, and then only until the writer frees a slot.
+    void push(const Record &record)
+    {
+        if (!writer.joinable())
+            return;
+        while (!records.try_push(record))
+            std::this_thread::yield();
+        published.fetch_add(1, std::memory_order_release);
+        published.notify_one();
+    }
+
+    void write_records()
+    {
+        EvalBoard board;
+        std::map<std::uint32_t, PgnGame> games;
+        std::string batch;
+        Record record;
+        while (true)
+        {
+            // closing is read before the drain: a record pushed before it was set is then drained below.
+            const std::uint32_t seen = published.load(std::memory_order_acquire);
+            const bool done = closing.load(std::memory_order_acquire);
+            while (records.try_pop(record))
+            {
+                format_record(record, board, games, batch);
+                if (batch.size() >= BATCH_BYTES)
+                {
+                    output << batch;
+                    batch.clear();
+                }
+            }
+            output << batch << std::flush;
+            batch.clear();
+            if (done)
+                return;
+            published.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    static std::string result_text(std::uint8_t result)
+    {
+        return result == 2 ? "1-0" : result == 1 ? "1/2-1/2" : result == 0 ? "0-1" : "*";
+    }
+
+    // Static evaluation, for the side to move, as the interactive log has always shown it.
+    static int evaluate(const chess::Board &board)
+    {
+        return Evaluation(board, board.sideToMove()).static_eval();
+    }
+
+    void format_record(const Record &record, EvalBoard &board, std::map<std::uint32_t, PgnGame> &games, std::string &batch)
+    {
+        board.load(record.position);
+        const bool eval = level == LogLevel::EVAL;
+        std::ostringstream out;
+
+        if (record.kind == Kind::START)
+        {
+            if (format == LogFormat::TEXT)
+            {
+                out << static_cast<const chess::Board &>(board) << '\n';
+                if (eval)
+                    out << "Move evaluation: " << evaluate(board) << '\n';
+            }
+            else if (format == LogFormat::JSONL)
+                out << "{\"game\":" << record.game << ",\"start\":\"" << board.getFen() << "\"}\n";
+            else
+                games[record.game] = {board.getFen(), static_cast<int>(board.fullMoveNumber()), board.sideToMove() == chess::Color::WHITE, {}};
+        }
+        else if (record.kind == Kind::MOVE)
+        {
+            const chess::Color side = board.sideToMove();
+            const std::string san = chess::uci::moveToSan(board, record.move);
+            const int ply = (board.fullMoveNumber() - 1) * 2 + (side == chess::Color::BLACK);
+            board.makeMove(record.move);
+            if (format == LogFormat::TEXT)
+            {
+                out << side << "'s move: " << record.move << "\nBoard fen: " << board.getFen() << "\nBoard after move:\n"
+                    << static_cast<const chess::Board &>(board) << '\n';
+                if (eval)
+                    out << "Move evaluation: " << evaluate(board) << '\n';
+            }
+            else if (format == LogFormat::JSONL)
+            {
+                out << "{\"game\":" << record.game << ",\"ply\":" << ply + 1 << ",\"move\":\"" << chess::uci::moveToUci(record.move)
+                    << "\",\"san\":\"" << san << "\",\"fen\":\"" << board.getFen() << '"';
+                if (eval)
+                    out << ",\"eval\":" << evaluate(board);
+                out << "}\n";
+            }
+            else
+                games[record.game].moves.push_back(eval ? san + " {" + std::to_string(evaluate(board)) + "}" : san);
+        }
+        else
+        {
+            const std::string result = result_text(record.position.result);
+            if (format == LogFormat::TEXT)
+                out << "Result: " << result << '\n';
+            else if (format == LogFormat::JSONL)
+                out << "{\"game\":" << record.game << ",\"result\":\"" << result << "\"}\n";
+            else if (auto found = games.find(record.game); found != games.end())
+            {
+                write_pgn(out, record.game, found->second, result);
+                games.erase(found);
+            }
+        }
+        batch += out.str();
+    }
+
+    static void write_pgn(std::ostream &out, std::uint32_t game, const PgnGame &pgn, const std::string &result)
+    {
+        out << "[Event \"Game " << game << "\"]\n[Result \"" << result << "\"]\n";
+        if (pgn.fen != chess::constants::STARTPOS)
+            out << "[SetUp \"1\"]\n[FEN \"" << pgn.fen << "\"]\n";
+        out << '\n';
+
+        int number = pgn.first_move;
+        bool white = pgn.white_first;
+        std::size_t column = 0;
+        for (std::size_t ply = 0; ply < pgn.moves.size(); ++ply)
+        {
+            std::string word = white ? std::to_string(number) + ". " + pgn.moves[ply]
+                               : ply == 0 ? std::to_string(number) + "... " + pgn.moves[ply]
+                                          : pgn.moves[ply];
+            if (column && column + 1 + word.size() > 80)
+            {
+                out << '\n';
+                column = 0;
+            }
+            out << (column ? " " : "") << word;
+            column += (column ? 1 : 0) + word.size();
+            number += !white;
+            white = !white;
+        }
+        out << (column ? " " : "") << result << "\n\n";
+    }
+};
+
+#endif
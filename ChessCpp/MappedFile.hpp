@@ -0,0 +1,62 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+A whole file mapped read-only into memory (POSIX). Pages are read in by the kernel as they
+are touched, so a reader can walk records in place without copying them into buffers.
+data() is null if the file could not be opened or mapped. */
+class MappedFile
+{
+public:
+    // How the file will be read, passed on to the kernel's read-ahead.
+    enum class Access
+    {
+        SEQUENTIAL, // Front to back, e.g. a dataset
+        RANDOM      // Scattered lookups, e.g. a binary search
+    };
+
+    explicit MappedFile(const std::string &path, Access access = Access::SEQUENTIAL)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *mapped = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                bytes = static_cast<const char *>(mapped);
+                length = static_cast<std::size_t>(info.st_size);
+                madvise(mapped, length, access == Access::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (bytes)
+            munmap(const_cast<char *>(bytes), length);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+private:
+    const char *bytes = nullptr;
+    std::size_t length = 0;
+};
+
+#endif
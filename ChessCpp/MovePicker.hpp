@@ -0,0 +1,338 @@
+#ifndef MOVE_PICKER_HPP
+#define MOVE_PICKER_HPP
+
+#include "chess.hpp"
+#include "Eval.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Piece values for exchanges. The king is worth more than everything else combined.
+constexpr std::array<int, 6> see_values = {Evaluation::piece_values[0], Evaluation::piece_values[1], Evaluation::piece_values[2],
+                                           Evaluation::piece_values[3], Evaluation::piece_values[4], 20000};
+
+inline int see_value(chess::PieceType pt)
+{
+    return see_values[static_cast<int>(pt)];
+}
+
+// History scores, [side to move][from][to]. Kept within +/- HISTORY_MAX so they fit Move::setScore.
+using HistoryTable = std::array<std::array<std::array<int, 64>, 64>, 2>;
+constexpr int HISTORY_MAX = 16384;
+
+/// @brief Rewards (positive bonus) or punishes (negative) a quiet move. Scores saturate towards HISTORY_MAX.
+inline void update_history(int &entry, int bonus)
+{
+    bonus = std::clamp(bonus, -HISTORY_MAX, HISTORY_MAX);
+    entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+}
+
+/// @brief Returns true if the move neither captures nor promotes.
+inline bool is_quiet(const chess::Board &board, chess::Move move)
+{
+    return !board.isCapture(move) && move.typeOf() != chess::Move::PROMOTION;
+}
+
+// Killer slots for pickers that do not use killers.
+inline const std::array<chess::Move, 2> NO_KILLERS{};
+
+/*
+Checks a move that did not come from this position's move generator (TT or killer move)
+is legal here. Only the moving piece's moves are generated, which is far cheaper than a
+full legal move generation. */
+inline bool is_legal(const chess::Board &board, chess::Move move)
+{
+    if (move == chess::Move::NO_MOVE || move == chess::Move::NULL_MOVE)
+        return false;
+    chess::Piece piece = board.at(move.from());
+    if (piece == chess::Piece::NONE || piece.color() != board.sideToMove())
+        return false;
+
+    chess::Movelist moves;
+    chess::movegen::legalmoves(moves, board, 1 << static_cast<int>(piece.type()));
+    return std::find(moves.begin(), moves.end(), move) != moves.end();
+}
+
+/*
+Static exchange evaluation: the material balance, from the moving side's point of view,
+of the capture sequence on the move's target square when both sides always recapture
+with their least valuable piece and may stop whenever that is better for them.
+Pins are ignored. */
+inline int see(const chess::Board &board, chess::Move move)
+{
+    if (move.typeOf() == chess::Move::CASTLING)
+        return 0;
+
+    const chess::Square to = move.to();
+    const chess::Square from = move.from();
+    const Bitboard bishops_queens = board.pieces(PieceType::BISHOP) | board.pieces(PieceType::QUEEN);
+    const Bitboard rooks_queens = board.pieces(PieceType::ROOK) | board.pieces(PieceType::QUEEN);
+
+    std::array<int, 32> gain;
+    int d = 0;
+
+    Bitboard occupied = board.occ() ^ Bitboard::fromSquare(from);
+    PieceType on_target = board.at<PieceType>(from);
+    if (move.typeOf() == chess::Move::ENPASSANT)
+    {
+        gain[0] = see_value(PieceType::PAWN);
+        occupied ^= Bitboard::fromSquare(to.ep_square());
+    }
+    else
+    {
+        PieceType victim = board.at<PieceType>(to);
+        gain[0] = victim == PieceType::NONE ? 0 : see_value(victim);
+    }
+    if (move.typeOf() == chess::Move::PROMOTION)
+    {
+        on_target = move.promotionType();
+        gain[0] += see_value(on_target) - see_value(PieceType::PAWN);
+    }
+
+    Bitboard attackers = (chess::attacks::attackers(board, Color::WHITE, to) |
+                          chess::attacks::attackers(board, Color::BLACK, to)) & occupied;
+    Color side = ~board.sideToMove();
+
+    while (d < 31)
+    {
+        Bitboard ours = attackers & board.us(side);
+        if (!ours)
+            break;
+
+        // Least valuable attacker recaptures.
+        PieceType attacker = PieceType::NONE;
+        Bitboard from_bb;
+        for (PieceType::underlying pt : {PieceType::PAWN, PieceType::KNIGHT, PieceType::BISHOP,
+                                         PieceType::ROOK, PieceType::QUEEN, PieceType::KING})
+        {
+            Bitboard candidates = ours & board.pieces(pt);
+            if (candidates)
+            {
+                attacker = pt;
+                from_bb = Bitboard::fromSquare(candidates.lsb());
+                break;
+            }
+        }
+
+        ++d;
+        gain[d] = see_value(on_target) - gain[d - 1];
+
+        occupied ^= from_bb;
+        // Removing the attacker may uncover a slider behind it.
+        attackers |= (chess::attacks::bishop(to, occupied) & bishops_queens) |
+                     (chess::attacks::rook(to, occupied) & rooks_queens);
+        attackers &= occupied;
+        on_target = attacker;
+        side = ~side;
+    }
+
+    // Each side may decline to continue the exchange.
+    while (d > 0)
+    {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+        --d;
+    }
+    return gain[0];
+}
+
+/*
+Hands out a node's moves one at a time, best guess first, generating them only when needed:
+    1. the transposition table move,
+    2. captures that do not lose material, most valuable victim / least valuable attacker first,
+    3. the two killer moves of this ply,
+    4. the remaining quiet moves by history score,
+    5. captures that lose material (negative SEE).
+A beta cut-off on the TT move means no moves are generated at all.
+The quiescence search picker stops after step 2, so losing captures are pruned. Its step 2
+also has the quiet queen promotions, which the capture generator leaves out. */
+class MovePicker
+{
+public:
+    MovePicker(const chess::Board &board, chess::Move tt_move, const std::array<chess::Move, 2> &killers,
+               const HistoryTable &history)
+        : board(board), tt_move(tt_move), killers(killers), history(history)
+    {
+    }
+
+    /// @brief Quiescence search picker: only captures and queen promotions that do not lose material.
+    MovePicker(const chess::Board &board, const HistoryTable &history)
+        : board(board), tt_move(chess::Move::NO_MOVE), killers(NO_KILLERS), history(history),
+          captures_only(true), stage(Stage::GENERATE_CAPTURES)
+    {
+    }
+
+    /// @brief Returns the next move to search, or Move::NO_MOVE when all moves were handed out.
+    chess::Move next()
+    {
+        while (true)
+        {
+            switch (stage)
+            {
+            case Stage::TT_MOVE:
+                stage = Stage::GENERATE_CAPTURES;
+                generations += tt_move != chess::Move::NO_MOVE;
+                if (is_legal(board, tt_move))
+                    return tt_move;
+                tt_move = chess::Move::NO_MOVE;
+                break;
+
+            case Stage::GENERATE_CAPTURES:
+                chess::movegen::legalmoves<chess::movegen::MoveGenType::CAPTURE>(moves, board);
+                ++generations;
+                if (captures_only)
+                    add_quiet_queen_promotions();
+                score_captures();
+                index = 0;
+                stage = Stage::GOOD_CAPTURES;
+                break;
+
+            case Stage::GOOD_CAPTURES:
+                while (index < moves.size())
+                {
+                    chess::Move move = pick_best();
+                    if (move == tt_move)
+                        continue;
+                    if (see(board, move) < 0)
+                    {
+                        bad_captures.add(move);
+                        continue;
+                    }
+                    return move;
+                }
+                stage = captures_only ? Stage::DONE : Stage::KILLERS;
+                killer_index = 0;
+                break;
+
+            case Stage::KILLERS:
+                while (killer_index < 2)
+                {
+                    chess::Move killer = killers[killer_index++];
+                    if (killer == chess::Move::NO_MOVE || killer == tt_move || !is_quiet(board, killer))
+                        continue;
+                    ++generations;
+                    if (is_legal(board, killer))
+                        return killer;
+                }
+                stage = Stage::GENERATE_QUIETS;
+                break;
+
+            case Stage::GENERATE_QUIETS:
+                chess::movegen::legalmoves<chess::movegen::MoveGenType::QUIET>(moves, board);
+                ++generations;
+                score_quiets();
+                index = 0;
+                stage = Stage::QUIETS;
+                break;
+
+            case Stage::QUIETS:
+                while (index < moves.size())
+                {
+                    chess::Move move = pick_best();
+                    if (move == tt_move || move == killers[0] || move == killers[1])
+                        continue;
+                    return move;
+                }
+                stage = Stage::BAD_CAPTURES;
+                index = 0;
+                break;
+
+            case Stage::BAD_CAPTURES:
+                if (index < bad_captures.size())
+                    return bad_captures[index++];
+                stage = Stage::DONE;
+                break;
+
+            case Stage::DONE:
+                return chess::Move::NO_MOVE;
+            }
+        }
+    }
+
+    /// @brief True if the last move handed out came after the TT move, good captures and killers.
+    /// Those are the moves the search reduces.
+    bool late_stage() const { return stage == Stage::QUIETS || stage == Stage::BAD_CAPTURES || stage == Stage::DONE; }
+
+    /// @brief Number of (full or partial) legal move generations this picker has done so far.
+    int movegen_calls() const { return generations; }
+
+private:
+    enum class Stage
+    {
+        TT_MOVE,
+        GENERATE_CAPTURES,
+        GOOD_CAPTURES,
+        KILLERS,
+        GENERATE_QUIETS,
+        QUIETS,
+        BAD_CAPTURES,
+        DONE
+    };
+
+    const chess::Board &board;
+    chess::Move tt_move;
+    const std::array<chess::Move, 2> &killers;
+    const HistoryTable &history;
+    bool captures_only = false;
+
+    Stage stage = Stage::TT_MOVE;
+    chess::Movelist moves;
+    chess::Movelist bad_captures;
+    int index = 0;
+    int killer_index = 0;
+    int generations = 0;
+
+    // Pawn moves to the last rank that capture nothing, when a pawn stands on the rank before it.
+    void add_quiet_queen_promotions()
+    {
+        const chess::Color us = board.sideToMove();
+        const Bitboard seventh(us == chess::Color::WHITE ? 0x00FF000000000000ULL : 0x000000000000FF00ULL);
+        if (!(board.pieces(PieceType::PAWN, us) & seventh))
+            return;
+        chess::Movelist pawn_moves;
+        chess::movegen::legalmoves<chess::movegen::MoveGenType::QUIET>(pawn_moves, board, chess::PieceGenType::PAWN);
+        ++generations;
+        for (const chess::Move &move : pawn_moves)
+            if (move.typeOf() == chess::Move::PROMOTION && move.promotionType() == PieceType::QUEEN)
+                moves.add(move);
+    }
+
+    // MVV-LVA: the victim decides first, a cheaper attacker breaks ties.
+    void score_captures()
+    {
+        for (chess::Move &move : moves)
+        {
+            PieceType victim = move.typeOf() == chess::Move::ENPASSANT ? PieceType(PieceType::PAWN) : board.at<PieceType>(move.to());
+            int score = 10 * (victim == PieceType::NONE ? 0 : see_value(victim)) - see_value(board.at<PieceType>(move.from())) / 100;
+            if (move.typeOf() == chess::Move::PROMOTION)
+                score += see_value(move.promotionType());
+            move.setScore(static_cast<std::int16_t>(score));
+        }
+    }
+
+    void score_quiets()
+    {
+        const auto &side_history = history[board.sideToMove()];
+        for (chess::Move &move : moves)
+        {
+            int score = side_history[move.from().index()][move.to().index()];
+            // Quiet promotions are generated here too; try them before any other quiet move.
+            if (move.typeOf() == chess::Move::PROMOTION)
+                score = HISTORY_MAX + see_value(move.promotionType());
+            move.setScore(static_cast<std::int16_t>(std::min(score, 32767)));
+        }
+    }
+
+    // One step of selection sort: swaps the best remaining move to the front and returns it.
+    chess::Move pick_best()
+    {
+        int best = index;
+        for (int i = index + 1; i < moves.size(); ++i)
+            if (moves[i].score() > moves[best].score())
+                best = i;
+        std::swap(moves[index], moves[best]);
+        return moves[index++];
+    }
+};
+
+#endif
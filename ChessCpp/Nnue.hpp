@@ -0,0 +1,177 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include "chess.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_AVX2
+#endif
+
+/*
+An NNUE ("efficiently updatable neural network") evaluation:
+
+    768 inputs -> HIDDEN per side, SCReLU -> 1 output
+
+Each input is one piece type and colour on one square, seen from one side: that side's own
+pieces come first, and black sees the board flipped so both sides look up the board. The
+first layer is a sum of weight rows over the pieces on the board, so it is kept up to date
+one piece at a time as moves are made and unmade (see EvalBoard), exactly like the classical
+piece-square sums. Evaluating is then only the output layer: the side to move's accumulator
+and the other side's, clipped to [0, 1] and squared (SCReLU), dotted with the output weights.
+
+The network file is the quantised layout the bullet trainer writes for this shape, every
+value a little-endian int16 (x86 order, read in place):
+    feature weights [768][HIDDEN], feature biases [HIDDEN], output weights [2][HIDDEN],
+    output bias, zero padding up to a multiple of 64 bytes.
+Accumulator values are quantised by QA and output weights by QB. */
+namespace Nnue
+{
+    constexpr int INPUTS = 768;
+    constexpr int HIDDEN = 256;
+    constexpr int QA = 255;    // The accumulator's 1.0
+    constexpr int QB = 64;     // The output weights' 1.0
+    constexpr int SCALE = 400; // Centipawns per unit of network output
+
+    constexpr std::size_t WEIGHT_BYTES = (INPUTS * HIDDEN + HIDDEN + 2 * HIDDEN + 1) * sizeof(std::int16_t);
+
+    /// @brief Input index of a piece on a square, from one side's point of view.
+    inline int feature(chess::Color perspective, chess::Piece piece, chess::Square sq)
+    {
+        const int side = piece.color() == perspective ? 0 : 1;
+        const int square = perspective == chess::Color::WHITE ? sq.index() : sq.index() ^ 56;
+        return side * 384 + static_cast<int>(piece.type()) * 64 + square;
+    }
+
+    // A network file, memory mapped. Every search thread reads the same pages.
+    class Network
+    {
+    public:
+        /// @brief Maps a network file, replacing the loaded one. An empty path just unloads it.
+        /// @return false if the file is missing or is not a network of this shape
+        bool open(const std::string &path)
+        {
+            if (path.empty())
+            {
+                file.reset();
+                return false;
+            }
+            file.emplace(path, MappedFile::Access::RANDOM);
+            const std::size_t size = file->size();
+            if (!file->data() || (size != WEIGHT_BYTES && size != (WEIGHT_BYTES + 63) / 64 * 64))
+                file.reset();
+            return is_loaded();
+        }
+
+        bool is_loaded() const { return file.has_value(); }
+
+        // HIDDEN weights of one input.
+        const std::int16_t *feature_weights(int feature) const { return values() + feature * HIDDEN; }
+        const std::int16_t *feature_biases() const { return values() + INPUTS * HIDDEN; }
+        // HIDDEN weights for the side to move's accumulator, then HIDDEN for the other side's.
+        const std::int16_t *output_weights() const { return feature_biases() + HIDDEN; }
+        int output_bias() const { return output_weights()[2 * HIDDEN]; }
+
+    private:
+        std::optional<MappedFile> file;
+
+        const std::int16_t *values() const { return reinterpret_cast<const std::int16_t *>(file->data()); }
+    };
+
+    // The network the NNUE backend evaluates with.
+    inline Network network;
+
+    /*
+    The first layer for both sides: the feature biases plus the weight rows of every piece on
+    the board. Adding and removing pieces is exact integer arithmetic, so a sequence of moves
+    and their unmakes always comes back to the same values. */
+    struct alignas(64) Accumulator
+    {
+        std::array<std::array<std::int16_t, HIDDEN>, 2> values = {}; // [perspective]
+
+        void add(chess::Piece piece, chess::Square sq) { update<1>(piece, sq); }
+        void remove(chess::Piece piece, chess::Square sq) { update<-1>(piece, sq); }
+
+        /// @brief Recomputes both sides from scratch.
+        void refresh(const chess::Board &board)
+        {
+            for (int side = 0; side < 2; ++side)
+                std::copy_n(network.feature_biases(), HIDDEN, values[side].begin());
+            chess::Bitboard occupied = board.occ();
+            while (occupied)
+            {
+                const chess::Square sq = occupied.pop();
+                add(board.at(sq), sq);
+            }
+        }
+
+        bool operator==(const Accumulator &other) const = default;
+
+    private:
+        // Plain loops over int16, which the compiler vectorises for whatever the target has.
+        // The pointers are restrict so it does not have to guard against the row overlapping the accumulator.
+        template <int SIGN>
+        void update(chess::Piece piece, chess::Square sq)
+        {
+            for (chess::Color perspective : {chess::Color(chess::Color::WHITE), chess::Color(chess::Color::BLACK)})
+                add_row<SIGN>(values[perspective].data(), network.feature_weights(feature(perspective, piece, sq)));
+        }
+
+        template <int SIGN>
+        static void add_row(std::int16_t *__restrict side, const std::int16_t *__restrict weights)
+        {
+            for (int i = 0; i < HIDDEN; ++i)
+                side[i] = static_cast<std::int16_t>(side[i] + SIGN * weights[i]);
+        }
+    };
+
+    /*
+    Sum over i of SCReLU(accumulator[i]) * weights[i], in accumulator and weight units.
+    The product is formed as (v * w) * v with v * w in 16 bits, which holds for weights up to
+    QB * 2 and is what the AVX2 version computes with a 16 bit multiply and a multiply-add. */
+    inline int screlu_dot(const std::int16_t *accumulator, const std::int16_t *weights)
+    {
+#ifdef NNUE_AVX2
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi16(QA);
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < HIDDEN; i += 16)
+        {
+            const __m256i v = _mm256_min_epi16(_mm256_max_epi16(_mm256_load_si256(reinterpret_cast<const __m256i *>(accumulator + i)), zero), one);
+            const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_mullo_epi16(v, w), v));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(half);
+#else
+        int sum = 0;
+        for (int i = 0; i < HIDDEN; ++i)
+        {
+            const int v = std::clamp<int>(accumulator[i], 0, QA);
+            sum += static_cast<std::int16_t>(v * weights[i]) * v;
+        }
+        return sum;
+#endif
+    }
+
+    /// @brief Network score in centipawns, from the side to move's point of view.
+    inline int evaluate(const Accumulator &accumulator, chess::Color side_to_move)
+    {
+        const std::int16_t *weights = network.output_weights();
+        const int sum = screlu_dot(accumulator.values[side_to_move].data(), weights) +
+                        screlu_dot(accumulator.values[~side_to_move].data(), weights + HIDDEN);
+        return (sum / QA + network.output_bias()) * SCALE / (QA * QB);
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef OPENING_BOOK_HPP
+#define OPENING_BOOK_HPP
+
+#include "chess.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// One move of a book position, with the weight the book gives it.
+struct BookMove
+{
+    chess::Move move = chess::Move::NO_MOVE;
+    int weight = 0;
+};
+
+/*
+A Polyglot opening book (.bin), memory mapped. The file is a sorted array of 16 byte big-endian
+entries: key, move, weight and a learn field that is ignored. chess::Board::hash() is the
+Polyglot key already (chess.hpp's Zobrist numbers are Polyglot's table, with the same en
+passant rule), so a lookup is a binary search for the board's own hash, nothing recomputed.
+Only standard chess: Chess960 castling rights hash differently. */
+class OpeningBook
+{
+public:
+    /// @brief Maps a book file, replacing the open one. An empty path just closes the book.
+    /// @return true if the file holds at least one entry
+    bool open(const std::string &path)
+    {
+        file.reset();
+        count = 0;
+        if (path.empty())
+            return false;
+        file.emplace(path, MappedFile::Access::RANDOM);
+        count = file->size() / ENTRY_SIZE;
+        if (!count)
+            file.reset();
+        return count > 0;
+    }
+
+    bool is_open() const { return count > 0; }
+
+    /// @brief Every legal book move of the position. Entries whose move is not legal here (a key collision) are skipped.
+    std::vector<BookMove> moves(const chess::Board &board) const
+    {
+        std::vector<BookMove> found;
+        if (!count)
+            return found;
+
+        const std::uint64_t key = board.hash();
+        std::size_t low = 0, high = count;
+        while (low < high)
+        {
+            const std::size_t middle = low + (high - low) / 2;
+            if (read(middle * ENTRY_SIZE, 8) < key)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        chess::Movelist legal;
+        chess::movegen::legalmoves(legal, board);
+        for (std::size_t i = low; i < count && read(i * ENTRY_SIZE, 8) == key; ++i)
+        {
+            const std::uint16_t encoded = static_cast<std::uint16_t>(read(i * ENTRY_SIZE + 8, 2));
+            const int weight = static_cast<int>(read(i * ENTRY_SIZE + 10, 2));
+            for (const chess::Move &move : legal)
+                if (polyglot_move(move) == encoded)
+                {
+                    found.push_back({move, weight});
+                    break;
+                }
+        }
+        return found;
+    }
+
+    /*
+    Picks a book move at random, each with a chance proportional to its weight, so games out of
+    the same book do not all follow one line.
+    @param best_only Always take the heaviest move instead
+    @return Move::NO_MOVE if the position is not in the book */
+    chess::Move probe(const chess::Board &board, bool best_only = false)
+    {
+        const std::vector<BookMove> candidates = moves(board);
+        if (candidates.empty())
+            return chess::Move::NO_MOVE;
+
+        int total = 0;
+        const BookMove *best = &candidates[0];
+        for (const BookMove &candidate : candidates)
+        {
+            total += candidate.weight;
+            if (candidate.weight > best->weight)
+                best = &candidate;
+        }
+        if (best_only || total == 0)
+            return best->move;
+
+        int pick = std::uniform_int_distribution<int>(0, total - 1)(random);
+        for (const BookMove &candidate : candidates)
+        {
+            if (pick < candidate.weight)
+                return candidate.move;
+            pick -= candidate.weight;
+        }
+        return best->move;
+    }
+
+    /// @brief A move in Polyglot's encoding: to square, from square, promotion piece (1 knight .. 4 queen).
+    /// Castling is king takes own rook, which is also how chess.hpp stores it.
+    static std::uint16_t polyglot_move(chess::Move move)
+    {
+        int encoded = move.to().index() | move.from().index() << 6;
+        if (move.typeOf() == chess::Move::PROMOTION)
+            encoded |= (static_cast<int>(move.promotionType()) - static_cast<int>(chess::PieceType(chess::PieceType::KNIGHT)) + 1) << 12;
+        return static_cast<std::uint16_t>(encoded);
+    }
+
+private:
+    static constexpr std::size_t ENTRY_SIZE = 16;
+
+    std::optional<MappedFile> file;
+    std::size_t count = 0;
+    std::mt19937 random{std::random_device{}()};
+
+    // A big-endian field of the mapped file.
+    std::uint64_t read(std::size_t offset, int bytes) const
+    {
+        std::uint64_t value = 0;
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(file->data()) + offset;
+        for (int i = 0; i < bytes; ++i)
+            value = value << 8 | data[i];
+        return value;
+    }
+};
+
+// The book the front ends play from. Only they consult it: analysis and benchmarks always search.
+inline OpeningBook opening_book;
+
+#endif
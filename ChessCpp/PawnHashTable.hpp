@@ -0,0 +1,96 @@
+#ifndef PAWN_HASH_TABLE_HPP
+#define PAWN_HASH_TABLE_HPP
+
+#include "chess.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+/*
+One cached pawn structure, 16 bytes so four share a cache line. Pawns never stand on the
+first or last rank, so each side's pawns fit in 48 bits: white's fill the low word with the
+first 16 bits of black's, the rest of black's sits next to the score. The key is still
+stored in full, so a hit can never be another structure's score. A zeroed entry is the
+pawnless position, whose score is 0, so an empty table needs no separate valid flag. */
+struct PawnHashEntry
+{
+    std::uint64_t white_and_black_low = 0;
+    std::uint32_t black_high = 0;
+    std::int32_t score = 0; // Pawn-only terms of Evaluation::pawn_score, white minus black
+
+    static PawnHashEntry make(chess::Bitboard white_pawns, chess::Bitboard black_pawns, std::int32_t score)
+    {
+        const std::uint64_t white = white_pawns.getBits() >> 8, black = black_pawns.getBits() >> 8;
+        return {white | black << 48, static_cast<std::uint32_t>(black >> 16), score};
+    }
+
+    bool matches(chess::Bitboard white_pawns, chess::Bitboard black_pawns) const
+    {
+        const std::uint64_t white = white_pawns.getBits() >> 8, black = black_pawns.getBits() >> 8;
+        return white_and_black_low == (white | black << 48) && black_high == static_cast<std::uint32_t>(black >> 16);
+    }
+};
+
+static_assert(sizeof(PawnHashEntry) == 16, "Four pawn hash entries per cache line");
+
+/*
+Direct-mapped cache of the pawn structure terms of the evaluation. They depend on nothing
+but the pawn bitboards, which most moves leave alone, so nearly every lookup in a search
+is a hit. Each thread has its own table (see pawn_hash_table), so there is no locking and
+no torn entry to guard against. */
+class PawnHashTable
+{
+private:
+    std::vector<PawnHashEntry> entries;
+    int shift; // 64 - log2(entry count)
+
+    PawnHashEntry &slot(chess::Bitboard white_pawns, chess::Bitboard black_pawns)
+    {
+        // Multiplicative hash of both bitboards. Only the high bits of a product depend on every input bit.
+        std::uint64_t h = white_pawns.getBits() * 0x9E3779B97F4A7C15ULL ^ black_pawns.getBits() * 0xC2B2AE3D27D4EB4FULL;
+        return entries[h >> shift];
+    }
+
+public:
+    static constexpr std::size_t DEFAULT_ENTRIES = 1 << 14; // Power of two, 256 KB
+
+    std::uint64_t probes = 0;
+    std::uint64_t hits = 0;
+
+    /// @param entry_count Number of entries, a power of two
+    explicit PawnHashTable(std::size_t entry_count = DEFAULT_ENTRIES) : entries(entry_count), shift(64 - std::countr_zero(entry_count)) {}
+
+    /// @brief Looks up a pawn structure.
+    /// @param score Filled with the cached score on a hit
+    /// @return true if the structure was found
+    bool probe(chess::Bitboard white_pawns, chess::Bitboard black_pawns, int &score)
+    {
+        ++probes;
+        const PawnHashEntry &entry = slot(white_pawns, black_pawns);
+        if (!entry.matches(white_pawns, black_pawns))
+            return false;
+        ++hits;
+        score = entry.score;
+        return true;
+    }
+
+    /// @brief Stores a pawn structure's score, replacing whatever shared its slot.
+    void store(chess::Bitboard white_pawns, chess::Bitboard black_pawns, int score)
+    {
+        slot(white_pawns, black_pawns) = PawnHashEntry::make(white_pawns, black_pawns, score);
+    }
+
+    void clear()
+    {
+        std::fill(entries.begin(), entries.end(), PawnHashEntry{});
+        probes = hits = 0;
+    }
+
+    double hit_rate() const { return probes ? static_cast<double>(hits) / probes : 0.0; }
+};
+
+// One table per thread: search threads, the UCI worker and the benchmarks each warm their own.
+inline thread_local PawnHashTable pawn_hash_table;
+
+#endif
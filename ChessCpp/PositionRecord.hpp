@@ -0,0 +1,148 @@
+#ifndef POSITION_RECORD_HPP
+#define POSITION_RECORD_HPP
+
+#include "chess.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <type_traits>
+
+/*
+A position in 32 bytes, for datasets. Pieces are listed in square order of the occupancy
+bitboard, one chess::Piece per nibble, so at most 32 pieces fit (any legal position).
+Castling is stored as the four standard rights; Chess960 rook files are not kept.
+Load it into a board with EvalBoard::load(), which does not go through FEN. */
+struct PositionRecord
+{
+    static constexpr std::uint8_t NO_RESULT = 255;
+
+    std::uint64_t occupancy = 0;
+    std::array<std::uint8_t, 16> pieces = {}; // Low nibble first
+    std::uint8_t flags = 0;                    // Bit 0: black to move. Bits 1-4: castling KQkq
+    std::uint8_t ep_square = 64;               // 64 if none
+    std::uint8_t halfmove_clock = 0;
+    std::uint8_t result = NO_RESULT;           // White's result: 0 loss, 1 draw, 2 win
+    std::int16_t score = 0;                    // Centipawns, white positive, e.g. a search score
+    std::uint16_t fullmove_number = 1;
+
+    static constexpr std::uint8_t BLACK_TO_MOVE = 1;
+    static constexpr std::uint8_t WHITE_KING_SIDE = 1 << 1;
+    static constexpr std::uint8_t WHITE_QUEEN_SIDE = 1 << 2;
+    static constexpr std::uint8_t BLACK_KING_SIDE = 1 << 3;
+    static constexpr std::uint8_t BLACK_QUEEN_SIDE = 1 << 4;
+
+    chess::Piece piece(int index) const
+    {
+        return chess::Piece(static_cast<chess::Piece::underlying>((pieces[index / 2] >> (index % 2 * 4)) & 0xF));
+    }
+
+    /// @brief Encodes a board. Score and result are left for the caller to fill in.
+    static PositionRecord from_board(const chess::Board &board)
+    {
+        PositionRecord record;
+        chess::Bitboard occupied = board.occ();
+        record.occupancy = occupied.getBits();
+        int index = 0;
+        while (occupied && index < 32)
+        {
+            const int piece = static_cast<int>(board.at(occupied.pop()));
+            record.pieces[index / 2] |= static_cast<std::uint8_t>(piece << (index % 2 * 4));
+            ++index;
+        }
+
+        using Side = chess::Board::CastlingRights::Side;
+        const chess::Board::CastlingRights rights = board.castlingRights();
+        record.flags = (board.sideToMove() == chess::Color::BLACK ? BLACK_TO_MOVE : 0) |
+                       (rights.has(chess::Color::WHITE, Side::KING_SIDE) ? WHITE_KING_SIDE : 0) |
+                       (rights.has(chess::Color::WHITE, Side::QUEEN_SIDE) ? WHITE_QUEEN_SIDE : 0) |
+                       (rights.has(chess::Color::BLACK, Side::KING_SIDE) ? BLACK_KING_SIDE : 0) |
+                       (rights.has(chess::Color::BLACK, Side::QUEEN_SIDE) ? BLACK_QUEEN_SIDE : 0);
+        const chess::Square ep = board.enpassantSq();
+        record.ep_square = ep == chess::Square::underlying::NO_SQ ? 64 : static_cast<std::uint8_t>(ep.index());
+        record.halfmove_clock = static_cast<std::uint8_t>(std::min<std::uint32_t>(board.halfMoveClock(), 255));
+        record.fullmove_number = static_cast<std::uint16_t>(std::min<std::uint32_t>(board.fullMoveNumber(), 65535));
+        return record;
+    }
+};
+
+static_assert(sizeof(PositionRecord) == 32, "A position record is 32 bytes");
+static_assert(std::is_trivially_copyable_v<PositionRecord>, "Records are read straight from mapped memory");
+
+// Start of a position file; the records follow directly.
+struct PositionFileHeader
+{
+    char magic[4] = {'P', 'O', 'S', '1'};
+    std::uint32_t record_size = sizeof(PositionRecord);
+    std::uint64_t record_count = 0;
+};
+
+static_assert(sizeof(PositionFileHeader) % alignof(PositionRecord) == 0, "Records after the header stay aligned");
+
+// Appends records to a new position file. The header's count is written when the writer is destroyed.
+class PositionWriter
+{
+public:
+    explicit PositionWriter(const std::string &path) : out(path, std::ios::binary)
+    {
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    ~PositionWriter()
+    {
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    PositionWriter(const PositionWriter &) = delete;
+    PositionWriter &operator=(const PositionWriter &) = delete;
+
+    bool good() const { return out.good(); }
+    std::uint64_t count() const { return header.record_count; }
+
+    void write(const PositionRecord &record)
+    {
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        ++header.record_count;
+    }
+
+private:
+    std::ofstream out;
+    PositionFileHeader header;
+};
+
+/*
+A position file mapped into memory. records() points straight into the mapping, nothing is
+copied or parsed. A missing, truncated or foreign file reads as empty. */
+class PositionFile
+{
+public:
+    explicit PositionFile(const std::string &path) : file(path)
+    {
+        if (!file.data() || file.size() < sizeof(PositionFileHeader))
+            return;
+        PositionFileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        const PositionFileHeader expected;
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.record_size != sizeof(PositionRecord) ||
+            sizeof(header) + header.record_count * sizeof(PositionRecord) > file.size())
+            return;
+        count = header.record_count;
+    }
+
+    std::span<const PositionRecord> records() const
+    {
+        return {reinterpret_cast<const PositionRecord *>(file.data() + sizeof(PositionFileHeader)), count};
+    }
+
+private:
+    MappedFile file;
+    std::size_t count = 0;
+};
+
+#endif
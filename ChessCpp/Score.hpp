@@ -0,0 +1,32 @@
+#ifndef SCORE_HPP
+#define SCORE_HPP
+
+#include <cstdint>
+
+/*
+A middlegame/endgame score pair packed into one int: the endgame half in the upper 16 bits,
+the middlegame half in the lower 16. Adding, subtracting and multiplying by an integer work
+on both halves at once, so terms are summed as pairs and only split once, by taper().
+Each half must stay within +/- 32767. */
+using Score = std::int32_t;
+
+constexpr Score make_score(int mg, int eg)
+{
+    return static_cast<Score>((static_cast<std::uint32_t>(eg) << 16) + static_cast<std::uint32_t>(mg));
+}
+
+constexpr int mg_value(Score score)
+{
+    return static_cast<std::int16_t>(static_cast<std::uint16_t>(static_cast<std::uint32_t>(score)));
+}
+
+// The rounding offset undoes the borrow a negative middlegame half takes from the endgame half.
+constexpr int eg_value(Score score)
+{
+    return static_cast<std::int16_t>(static_cast<std::uint16_t>((static_cast<std::uint32_t>(score) + 0x8000) >> 16));
+}
+
+static_assert(mg_value(make_score(-5, 7)) == -5 && eg_value(make_score(-5, 7)) == 7, "Packed score halves");
+static_assert(eg_value(make_score(3, -4) * 3 - make_score(-20, 10)) == -22, "Packed score arithmetic");
+
+#endif
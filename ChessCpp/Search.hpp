@@ -0,0 +1,813 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include "chess.hpp"
+#include "Eval.hpp"
+#include "MovePicker.hpp"
+#include "SearchStats.hpp"
+#include "Tablebase.hpp"
+#include "TimeManager.hpp"
+#include "TranspositionTable.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Shared by every search thread. Lock-free, see TranspositionTable.hpp.
+inline TranspositionTable transposition_table;
+
+// Raised by the main thread to make every helper unwind.
+inline std::atomic<bool> stop_search{false};
+
+// Deadlines of the running search. Only the main thread reads it.
+inline TimeManager time_manager;
+
+// Called by the main thread after every completed iteration, if set. The UCI front end prints from here.
+inline std::function<void(const IterationReport &)> on_iteration;
+
+// Delta pruning margin: a capture is skipped if even winning the victim plus this much cannot reach the window.
+constexpr int DELTA_MARGIN = 200;
+
+// Size of the per-ply tables. Leaves room for the search to go deeper than its nominal depth.
+constexpr int MAX_PLY = 128;
+
+/*
+Scores are negamax scores: from the side to move's point of view.
+Being mated at ply p scores -(MATE_SCORE - p), so shorter mates are preferred, and any
+score beyond MATE_BOUND is a forced mate. INFINITE_SCORE is outside every real score. */
+constexpr int MATE_SCORE = 99999;
+constexpr int MATE_BOUND = MATE_SCORE - MAX_PLY;
+constexpr int INFINITE_SCORE = MATE_SCORE + 1;
+
+// A tablebase win reached at ply p scores TB_WIN_SCORE - p: below every mate, above every evaluation.
+// Any score beyond TB_WIN_BOUND is a mate or a tablebase win, and depends on the distance from the root.
+constexpr int TB_WIN_SCORE = MATE_BOUND - MAX_PLY;
+constexpr int TB_WIN_BOUND = TB_WIN_SCORE - MAX_PLY;
+
+// Most lines a MultiPV search reports. More legal moves than this are rare.
+constexpr int MAX_MULTIPV = 256;
+
+// First aspiration window around the previous iteration's score, and the depth it starts at.
+constexpr int ASPIRATION_WINDOW = 25;
+constexpr int ASPIRATION_MIN_DEPTH = 4;
+
+/*
+Switches for the selective search, all on by default. Each can be turned off on its
+own to measure what it is worth (bench, or the UCI options of the same names).
+Only change them while no search is running. */
+struct SearchOptions
+{
+    bool null_move = true;        // Null move pruning
+    bool lmr = true;              // Late move reductions
+    bool reverse_futility = true; // Static null move pruning near the leaves
+    bool futility = true;         // Skips quiet moves near the leaves when the static eval is far below alpha
+    bool lazy_eval = true;        // Quiescence skips the expensive eval terms when the cheap ones are far outside the window
+};
+
+inline SearchOptions search_options;
+
+constexpr int NULL_MOVE_MIN_DEPTH = 3;
+constexpr int NULL_MOVE_VERIFY_DEPTH = 8;   // From this depth a null move cut-off is confirmed by a reduced search
+constexpr int REVERSE_FUTILITY_MAX_DEPTH = 6;
+constexpr int REVERSE_FUTILITY_MARGIN = 80; // Per ply of depth
+constexpr int FUTILITY_MAX_DEPTH = 3;
+constexpr int FUTILITY_MARGIN = 100;        // Per ply of depth, on top of FUTILITY_BASE
+constexpr int FUTILITY_BASE = 50;
+constexpr int LMR_MIN_DEPTH = 3;
+constexpr int LMR_MIN_MOVES = 3;            // Moves searched at full depth before reductions start
+
+// Late move reductions in plies, by [depth][moves searched]. Grows with the log of both.
+inline const std::array<std::array<int, 64>, MAX_SEARCH_DEPTH + 1> lmr_table = []
+{
+    std::array<std::array<int, 64>, MAX_SEARCH_DEPTH + 1> table{};
+    for (int depth = 1; depth <= MAX_SEARCH_DEPTH; ++depth)
+        for (int moves = 1; moves < 64; ++moves)
+            table[depth][moves] = static_cast<int>(0.75 + std::log(depth) * std::log(moves) / 2.25);
+    return table;
+}();
+
+/*
+What the threads of one search share. By default that is the engine's single search:
+the globals above. Independent searches running side by side (batch analysis) each
+bring their own table, stop flag and clock instead. */
+struct SearchContext
+{
+    TranspositionTable *tt = &transposition_table;
+    std::atomic<bool> *stop = &stop_search;
+    TimeManager *time = &time_manager;
+    const std::function<void(const IterationReport &)> *on_iteration = &::on_iteration; // Null for no reports
+};
+
+/*
+The working memory of one ply of the search: everything a node keeps while its children
+are searched. A node at ply p only writes stack[p], so the frames can be reused from node
+to node without any clearing, and a null move verification search, which runs at its own
+ply before that node picks any move, finds nothing of the node's in use yet. */
+struct SearchFrame
+{
+    std::optional<MovePicker> picker;               // Move list and move scores of the node
+    chess::Movelist evasions;                       // Quiescence search in check tries every evasion
+    chess::Movelist quiets_tried;                   // Quiet moves searched, for the history update
+    std::array<chess::Move, 2> killers{};           // Two quiet moves that caused a cut-off at this ply
+    int static_eval = -INFINITE_SCORE;              // -INFINITE_SCORE where it was not computed (PV nodes, in check)
+    std::array<chess::Move, MAX_PLY> pv{};          // pv[ply..pv_length) is the best line found from this ply
+    int pv_length = 0;
+};
+
+// One root move searched to an exact score in an iteration, with its line.
+struct RootLine
+{
+    chess::Move move = chess::Move::NO_MOVE;
+    int score = 0;
+    std::vector<chess::Move> pv;
+};
+
+/*
+Everything one search thread owns. Threads only share the transposition table,
+so each one searches its own copy of the board and keeps its own node count
+and move ordering heuristics. The board is an EvalBoard, so the material and
+piece-square sums follow every makeMove/unmakeMove the search makes.
+All of it is sized when the thread is created: the ply frames are a fixed array and the
+board's move history is reserved for MAX_PLY more moves, so searching never allocates. */
+struct SearchThread
+{
+    int id = 0;
+    SearchContext context;
+    EvalBoard board;
+    std::uint64_t nodes = 0;
+    SearchStats stats;
+    HistoryTable history{};
+    std::array<SearchFrame, MAX_PLY> stack;
+    std::vector<chess::Move> root_pv; // PV of the last completed iteration
+    std::vector<RootLine> root_lines; // Lines of the last completed iteration, best first (MultiPV)
+
+    SearchThread(int id, const chess::Board &board, const SearchContext &context = {}) : id(id), context(context), board(board)
+    {
+        this->board.reserve_history(MAX_PLY);
+        root_pv.reserve(MAX_PLY);
+    }
+
+    bool stopped() const { return context.stop->load(std::memory_order_relaxed); }
+
+    // Makes move followed by the child's line the PV of this ply.
+    void update_pv(int ply, chess::Move move)
+    {
+        SearchFrame &frame = stack[ply];
+        const SearchFrame &child = stack[ply + 1];
+        frame.pv[ply] = move;
+        for (int i = ply + 1; i < child.pv_length; ++i)
+            frame.pv[i] = child.pv[i];
+        frame.pv_length = std::max(child.pv_length, ply + 1);
+    }
+};
+
+/*
+Polled at every node. Only the main thread looks at the clock and the node budget,
+and only every TimeManager::POLL_INTERVAL nodes, so this is usually a single load. */
+inline bool search_stopped(const SearchThread &thread)
+{
+    if (thread.id == 0 && (thread.nodes & (TimeManager::POLL_INTERVAL - 1)) == 0 &&
+        thread.context.time->hard_limit_reached(thread.nodes))
+        thread.context.stop->store(true, std::memory_order_relaxed);
+    return thread.stopped();
+}
+
+// Classifies a search result against the window it was searched with.
+inline Bound bound_type(int value, int alpha, int beta)
+{
+    if (value <= alpha)
+        return Bound::UPPER;
+    if (value >= beta)
+        return Bound::LOWER;
+    return Bound::EXACT;
+}
+
+// Mate and tablebase win scores are stored relative to the node, not the root, so a TT hit at another ply reads the right distance.
+inline int value_to_tt(int value, int ply)
+{
+    if (value >= TB_WIN_BOUND)
+        return value + ply;
+    if (value <= -TB_WIN_BOUND)
+        return value - ply;
+    return value;
+}
+
+inline int value_from_tt(int value, int ply)
+{
+    if (value >= TB_WIN_BOUND)
+        return value - ply;
+    if (value <= -TB_WIN_BOUND)
+        return value + ply;
+    return value;
+}
+
+// Static eval from the side to move's point of view, with the selected backend.
+inline int evaluate_for_side(SearchThread &thread)
+{
+    count_stat(thread.stats.eval_calls);
+    if (eval_backend == EvalBackend::NNUE)
+        return thread.board.nnue_evaluate();
+    Evaluation evaluation(thread.board, chess::Color::WHITE);
+    int eval = evaluation.evaluate();
+    count_stat(thread.stats.pawn_hash_hits, evaluation.used_pawn_hash());
+    return thread.board.sideToMove() == chess::Color::WHITE ? eval : -eval;
+}
+
+/*
+Bookkeeping for a quiet move that caused a cut-off: it becomes the first killer of this ply,
+its history score goes up, and the quiet moves searched before it go down.
+@param quiets_tried Quiet moves searched at this node, the cut-off move last. */
+inline void update_quiet_stats(SearchThread &thread, int ply, int depth, chess::Move move, const chess::Movelist &quiets_tried)
+{
+    std::array<chess::Move, 2> &killers = thread.stack[ply].killers;
+    if (killers[0] != move)
+    {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+
+    auto &side_history = thread.history[thread.board.sideToMove()];
+    const int bonus = depth * depth;
+    for (const chess::Move &quiet : quiets_tried)
+    {
+        int &entry = side_history[quiet.from().index()][quiet.to().index()];
+        update_history(entry, quiet == move ? bonus : -bonus);
+    }
+}
+
+/*
+Static eval from the side to move's point of view for a node searching [alpha, beta], see
+Evaluation::evaluate_lazy(). Exact inside the window widened by LAZY_EVAL_MARGIN; beyond
+that it may be a bound, but one that falls on the same side of the window as the real eval. */
+inline int lazy_evaluate_for_side(SearchThread &thread, int alpha, int beta)
+{
+    // The network has no cheap part to stop after.
+    if (!search_options.lazy_eval || eval_backend == EvalBackend::NNUE)
+        return evaluate_for_side(thread);
+
+    count_stat(thread.stats.eval_calls);
+    Evaluation evaluation(thread.board, chess::Color::WHITE);
+    bool lazy = false;
+    const int eval = thread.board.sideToMove() == chess::Color::WHITE ? evaluation.evaluate_lazy(alpha, beta, lazy)
+                                                                      : -evaluation.evaluate_lazy(-beta, -alpha, lazy);
+    count_stat(thread.stats.pawn_hash_hits, evaluation.used_pawn_hash());
+    count_stat(thread.stats.lazy_evals, lazy);
+    return eval;
+}
+
+/*
+Quiescence search: resolves captures at the leaves so the static eval is only trusted in quiet positions.
+The side to move may stand pat on the static eval, except when in check, where every evasion is searched.
+Captures that lose material by SEE are never tried, and neither are captures that cannot bring the score
+back into the window even when the victim is won for free (delta pruning). */
+inline int Quiescence(SearchThread &thread, int ply, int alpha, int beta)
+{
+    EvalBoard &data = thread.board;
+    SearchFrame &frame = thread.stack[ply];
+    ++thread.nodes;
+    count_stat(thread.stats.qnodes);
+    frame.pv_length = ply;
+
+    if (search_stopped(thread))
+        return 0;
+
+    if (data.isRepetition(1) || data.isInsufficientMaterial())
+        return 0;
+
+    if (data.isHalfMoveDraw())
+        return data.getHalfMoveDrawType().first == chess::GameResultReason::CHECKMATE ? -MATE_SCORE + ply : 0;
+
+    if (ply >= MAX_PLY - 1)
+        return evaluate_for_side(thread);
+
+    int best = -INFINITE_SCORE;
+    // Searches one move and keeps the best score. Returns true on a beta cut-off.
+    auto search_move = [&](chess::Move move)
+    {
+        data.makeMove(move);
+        int score = -Quiescence(thread, ply + 1, -beta, -alpha);
+        data.unmakeMove(move);
+
+        if (score > best)
+        {
+            best = score;
+            if (score > alpha)
+            {
+                alpha = score;
+                thread.update_pv(ply, move);
+                if (alpha >= beta)
+                {
+                    count_stat(thread.stats.beta_cutoffs);
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    if (data.inCheck())
+    {
+        chess::Movelist &moves = frame.evasions;
+        chess::movegen::legalmoves(moves, data);
+        count_stat(thread.stats.movegen_calls);
+        if (moves.empty())
+            return -MATE_SCORE + ply;
+        for (const chess::Move &move : moves)
+            if (search_move(move))
+                break;
+        return best;
+    }
+
+    const int stand_pat = lazy_evaluate_for_side(thread, alpha, beta);
+    if (stand_pat >= beta)
+        return stand_pat;
+    alpha = std::max(alpha, stand_pat);
+    best = stand_pat;
+
+    MovePicker &picker = frame.picker.emplace(data, thread.history);
+    for (chess::Move move = picker.next(); move != chess::Move::NO_MOVE; move = picker.next())
+    {
+        PieceType victim = move.typeOf() == chess::Move::ENPASSANT ? PieceType(PieceType::PAWN) : data.at<PieceType>(move.to());
+        int gain = (victim == PieceType::NONE ? 0 : see_value(victim)) + DELTA_MARGIN; // No victim for a quiet promotion
+        if (move.typeOf() == chess::Move::PROMOTION)
+            gain += see_value(move.promotionType()) - see_value(PieceType::PAWN);
+        if (stand_pat + gain <= alpha)
+            continue; // Delta pruning
+
+        if (search_move(move))
+            break;
+    }
+    count_stat(thread.stats.movegen_calls, picker.movegen_calls());
+    return best;
+}
+
+/*
+What a node of the principal variation search is, known from how its parent called it.
+PV nodes have a full window; NON_PV nodes are searched with a null window (beta == alpha + 1).
+The root is search_root(). */
+enum class NodeType
+{
+    PV,
+    NON_PV
+};
+
+/*
+Principal variation search. The first move of a node is searched with the full window;
+every later move gets a null window scout first, and is only searched again with the
+full window if the scout says it beats alpha. Non-PV nodes are the only ones that take
+TT cut-offs and the only ones that are pruned (see SearchOptions).
+The node type is a template parameter, so PV and non-PV nodes compile to separate code
+and the PV-only and pruning-only paths cost no branch where they cannot happen.
+@param ply Distance from the root, indexes the killer moves and the PV table.
+@param allow_null False right after a null move, and in null move verification searches. */
+template <NodeType NT>
+int Negamax(SearchThread &thread, int depth, int ply, int alpha, int beta, bool allow_null = true)
+{
+    constexpr bool pv_node = NT == NodeType::PV;
+
+    if (depth <= 0)
+        return Quiescence(thread, ply, alpha, beta);
+
+    EvalBoard &data = thread.board;
+    SearchFrame &frame = thread.stack[ply];
+    ++thread.nodes;
+    frame.pv_length = ply;
+
+    // The result is thrown away once the search is stopped, so any value will do.
+    if (search_stopped(thread))
+        return 0;
+
+    // Draws that need no move generation. A single repetition is enough inside the search:
+    // if repeating was good once, it will be good again.
+    if (data.isRepetition(1) || data.isInsufficientMaterial())
+        return 0;
+
+    // Checkmate takes priority over the fifty move rule.
+    if (data.isHalfMoveDraw())
+        return data.getHalfMoveDrawType().first == chess::GameResultReason::CHECKMATE ? -MATE_SCORE + ply : 0;
+
+    if (ply >= MAX_PLY - 1)
+        return evaluate_for_side(thread);
+
+    // Mate distance pruning: no line from here can beat a mate that was already found closer to the root.
+    alpha = std::max(alpha, -MATE_SCORE + ply);
+    beta = std::min(beta, MATE_SCORE - ply - 1);
+    if (alpha >= beta)
+        return alpha;
+
+    std::size_t hash = data.hash();
+    TranspositionEntry entry;
+    chess::Move tt_move = chess::Move::NO_MOVE;
+    count_stat(thread.stats.tt_probes);
+    if (thread.context.tt->probe(hash, entry))
+    {
+        count_stat(thread.stats.tt_hits);
+        tt_move = entry.move();
+        if (!pv_node && entry.depth() >= depth)
+        {
+            int value = value_from_tt(entry.value(), ply);
+            if (entry.bound() == Bound::EXACT ||
+                (entry.bound() == Bound::LOWER && value >= beta) ||
+                (entry.bound() == Bound::UPPER && value <= alpha))
+            {
+                count_stat(thread.stats.tt_cutoffs);
+                return value;
+            }
+        }
+    }
+
+    // Tablebase cut-off. A win is only a lower bound (a real mate scores higher) and a loss an upper bound.
+    Tablebase::Wdl wdl;
+    if (Tablebase::probe_wdl(data, wdl))
+    {
+        count_stat(thread.stats.tb_hits);
+        const int value = wdl == Tablebase::Wdl::WIN ? TB_WIN_SCORE - ply : wdl == Tablebase::Wdl::LOSS ? -TB_WIN_SCORE + ply : static_cast<int>(wdl) - static_cast<int>(Tablebase::Wdl::DRAW);
+        const Bound bound = wdl == Tablebase::Wdl::WIN ? Bound::LOWER : wdl == Tablebase::Wdl::LOSS ? Bound::UPPER : Bound::EXACT;
+        if (bound == Bound::EXACT || (bound == Bound::LOWER && value >= beta) || (bound == Bound::UPPER && value <= alpha))
+        {
+            thread.context.tt->store(hash, value_to_tt(value, ply), std::min(depth + 6, MAX_SEARCH_DEPTH), bound, chess::Move::NO_MOVE);
+            return value;
+        }
+    }
+    const int alpha_orig = alpha;
+
+    const bool in_check = data.inCheck();
+    const int static_eval = (pv_node || in_check) ? -INFINITE_SCORE : evaluate_for_side(thread);
+    frame.static_eval = static_eval;
+    const bool can_prune = !pv_node && !in_check && std::abs(beta) < MATE_BOUND;
+
+    // Reverse futility pruning: so far above beta that a shallow search will not bring it back down.
+    if (search_options.reverse_futility && can_prune && depth <= REVERSE_FUTILITY_MAX_DEPTH &&
+        static_eval - REVERSE_FUTILITY_MARGIN * depth >= beta)
+        return static_eval;
+
+    // Null move pruning: if passing still fails high, a real move will too. Not in pawn endgames,
+    // where passing can be the best move (zugzwang) and the assumption breaks.
+    if (search_options.null_move && can_prune && allow_null && depth >= NULL_MOVE_MIN_DEPTH &&
+        static_eval >= beta && data.hasNonPawnMaterial(data.sideToMove()))
+    {
+        const int reduction = 3 + depth / 6;
+        data.makeNullMove();
+        int score = -Negamax<NodeType::NON_PV>(thread, depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+        data.unmakeNullMove();
+
+        if (score >= beta && !thread.stopped())
+        {
+            // Mates found after a pass are not real mates.
+            score = std::min(score, MATE_BOUND - 1);
+            if (depth < NULL_MOVE_VERIFY_DEPTH)
+                return score;
+            // Deep cut-offs are confirmed by a reduced search without null moves, which catches zugzwang.
+            if (Negamax<NodeType::NON_PV>(thread, depth - reduction, ply, beta - 1, beta, false) >= beta)
+                return score;
+        }
+    }
+
+    const bool futile = search_options.futility && can_prune && depth <= FUTILITY_MAX_DEPTH &&
+                        static_eval + FUTILITY_BASE + FUTILITY_MARGIN * depth <= alpha;
+
+    // Moves are generated lazily, a cut-off on an early move saves generating the rest.
+    MovePicker &picker = frame.picker.emplace(data, tt_move, frame.killers, thread.history);
+    chess::Movelist &quiets_tried = frame.quiets_tried;
+    quiets_tried.clear();
+    int moves_searched = 0;
+
+    int best = -INFINITE_SCORE;
+    chess::Move best_move = chess::Move::NO_MOVE;
+    for (chess::Move move = picker.next(); move != chess::Move::NO_MOVE; move = picker.next())
+    {
+        const bool quiet = is_quiet(data, move);
+        ++moves_searched;
+
+        data.makeMove(move);
+        const bool gives_check = data.inCheck();
+
+        // Futility pruning: a quiet move cannot lift a hopeless static eval up to alpha, unless it checks.
+        if (futile && quiet && moves_searched > 1 && !gives_check && best > -MATE_BOUND)
+        {
+            data.unmakeMove(move);
+            continue;
+        }
+        if (quiet)
+            quiets_tried.add(move);
+
+        int score;
+        if (moves_searched == 1)
+            score = -Negamax<NT>(thread, depth - 1, ply + 1, -beta, -alpha);
+        else
+        {
+            // Late quiet moves are searched shallower first, and again at full depth if they beat alpha anyway.
+            // Promotions come first among the quiets but are never reduced.
+            int reduction = 0;
+            if (search_options.lmr && depth >= LMR_MIN_DEPTH && moves_searched > LMR_MIN_MOVES &&
+                quiet && picker.late_stage() && !in_check && !gives_check)
+            {
+                reduction = lmr_table[std::min(depth, MAX_SEARCH_DEPTH)][std::min(moves_searched, 63)] - pv_node;
+                reduction = std::clamp(reduction, 0, depth - 2);
+            }
+
+            score = -Negamax<NodeType::NON_PV>(thread, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+            if (score > alpha && reduction > 0)
+                score = -Negamax<NodeType::NON_PV>(thread, depth - 1, ply + 1, -alpha - 1, -alpha);
+            if (pv_node && score > alpha && score < beta)
+                score = -Negamax<NodeType::PV>(thread, depth - 1, ply + 1, -beta, -alpha);
+        }
+        data.unmakeMove(move);
+
+        if (score > best)
+        {
+            best = score;
+            if (score > alpha)
+            {
+                alpha = score;
+                best_move = move;
+                thread.update_pv(ply, move);
+                if (alpha >= beta)
+                {
+                    count_stat(thread.stats.beta_cutoffs);
+                    count_stat(thread.stats.first_move_cutoffs, moves_searched == 1);
+                    if (quiet)
+                        update_quiet_stats(thread, ply, depth, move, quiets_tried);
+                    break;
+                }
+            }
+        }
+    }
+    count_stat(thread.stats.movegen_calls, picker.movegen_calls());
+
+    if (moves_searched == 0)
+        return in_check ? -MATE_SCORE + ply : 0;
+
+    // Values from an interrupted subtree are incomplete, keep them out of the shared table.
+    if (thread.stopped())
+        return 0;
+    thread.context.tt->store(hash, value_to_tt(best, ply), depth, bound_type(best, alpha_orig, beta), best_move);
+    return best;
+}
+
+/*
+Searches the root moves from moves[first] on, in the given order, with PVS inside the
+window [alpha, beta]. The moves before first are left out: with MultiPV they are the
+lines of this iteration already found. The best move found is rotated to moves[first],
+so a re-search or the next iteration starts with it. The result is a fail-soft bound
+like Negamax's. */
+inline int search_root(SearchThread &thread, chess::Movelist &moves, int first, int depth, int alpha, int beta)
+{
+    EvalBoard &data = thread.board;
+    thread.stack[0].pv_length = 0;
+
+    int best = -INFINITE_SCORE;
+    int best_index = first;
+    for (int i = first; i < moves.size(); ++i)
+    {
+        const chess::Move move = moves[i];
+        data.makeMove(move);
+        int score;
+        if (i == first)
+            score = -Negamax<NodeType::PV>(thread, depth - 1, 1, -beta, -alpha);
+        else
+        {
+            score = -Negamax<NodeType::NON_PV>(thread, depth - 1, 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta)
+                score = -Negamax<NodeType::PV>(thread, depth - 1, 1, -beta, -alpha);
+        }
+        data.unmakeMove(move);
+
+        if (thread.stopped())
+            break;
+
+        if (score > best)
+        {
+            best = score;
+            best_index = i;
+            if (score > alpha)
+            {
+                alpha = score;
+                thread.update_pv(0, move);
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+    std::rotate(moves.begin() + first, moves.begin() + best_index, moves.begin() + best_index + 1);
+    return best;
+}
+
+// Mate distance in moves for a mate score (negative if the side to move is mated), 0 for other scores.
+inline int mate_in(int score)
+{
+    if (score >= MATE_BOUND)
+        return (MATE_SCORE - score + 1) / 2;
+    if (score <= -MATE_BOUND)
+        return -(MATE_SCORE + score) / 2;
+    return 0;
+}
+
+/*
+Searches line `line` of an iteration: the best of moves[line..], to an exact score.
+From ASPIRATION_MIN_DEPTH on, it first searches a narrow window around the line's previous
+score and widens it on the side that failed until the score lands inside.
+The result is meaningless if the search was stopped. */
+inline int search_line(SearchThread &thread, chess::Movelist &moves, int line, int depth, int previous_score)
+{
+    int delta = ASPIRATION_WINDOW;
+    int alpha = -INFINITE_SCORE, beta = INFINITE_SCORE;
+    if (depth >= ASPIRATION_MIN_DEPTH)
+    {
+        alpha = std::max(previous_score - delta, -INFINITE_SCORE);
+        beta = std::min(previous_score + delta, INFINITE_SCORE);
+    }
+
+    while (true)
+    {
+        const int result = search_root(thread, moves, line, depth, alpha, beta);
+        if (thread.stopped())
+            return result;
+
+        if (result <= alpha)
+        {
+            // Fail low: the move may be worse than we thought, so keep beta close and lower alpha.
+            beta = (alpha + beta) / 2;
+            alpha = std::max(result - delta, -INFINITE_SCORE);
+        }
+        else if (result >= beta)
+            beta = std::min(result + delta, INFINITE_SCORE);
+        else
+            return result;
+        delta *= 2;
+    }
+}
+
+/*
+Iterative deepening on one thread. The main thread (id 0) searches depths 1..max_depth
+and returns the best move of the last iteration it completed. It stops early once
+its clock's soft limit is reached. Helper threads start one ply deeper on odd ids
+so the threads spread over different depths, and keep iterating until the main thread
+raises the stop flag.
+With multipv > 1 the main thread finds the best multipv root moves each iteration, one
+after the other: line k searches every move but the k - 1 already found. The later lines
+run on the table and heuristics the first one just filled, so they cost a fraction of it.
+Helpers search the best line only, which feeds the table all the lines read from. */
+inline chess::Move iterative_deepening(SearchThread &thread, int max_depth, int multipv = 1)
+{
+    EvalBoard &data = thread.board;
+    chess::Movelist moves;
+    chess::movegen::legalmoves(moves, data);
+    count_stat(thread.stats.movegen_calls);
+    if (moves.empty())
+        return chess::Move::NO_MOVE;
+    // With the position in the tablebases, only the moves that keep its value are searched.
+    if (Tablebase::filter_root_moves(data, moves))
+        count_stat(thread.stats.tb_hits);
+    if (moves.size() == 1)
+    {
+        thread.root_pv = {moves[0]};
+        return moves[0];
+    }
+
+    const bool is_main = thread.id == 0;
+    const int first_depth = is_main ? 1 : 1 + (thread.id & 1);
+    const int last_depth = is_main ? max_depth : MAX_SEARCH_DEPTH;
+    const int line_count = is_main ? std::clamp(multipv, 1, moves.size()) : 1;
+
+    // Something legal to play even if the first iteration does not finish in time.
+    chess::Move best_move = moves[0];
+    thread.root_pv = {best_move};
+    thread.root_lines.assign(line_count, RootLine{});
+    std::vector<RootLine> lines(line_count);
+    int stable_iterations = 0;
+    std::uint64_t previous_iteration_nodes = 0;
+
+    for (int depth = first_depth; depth <= last_depth; ++depth)
+    {
+        const std::uint64_t nodes_before = thread.nodes;
+
+        // Helpers try the root moves in a different order so they do not walk in lockstep.
+        if (!is_main)
+            std::rotate(moves.begin(), moves.begin() + (thread.id + depth) % moves.size(), moves.end());
+
+        for (int line = 0; line < line_count && !thread.stopped(); ++line)
+        {
+            RootLine &found = lines[line];
+            found.score = search_line(thread, moves, line, depth, thread.root_lines[line].score);
+            found.move = moves[line];
+            const SearchFrame &root = thread.stack[0];
+            found.pv.assign(root.pv.begin(), root.pv.begin() + root.pv_length);
+            if (found.pv.empty() || found.pv[0] != found.move)
+                found.pv = {found.move};
+        }
+
+        // An interrupted iteration is incomplete, the previous depth's move stands.
+        if (thread.stopped())
+            break;
+
+        // A later line can score above an earlier one when the search is unstable; the score decides.
+        std::stable_sort(lines.begin(), lines.end(), [](const RootLine &a, const RootLine &b) { return a.score > b.score; });
+        for (int line = 0; line < line_count; ++line)
+            moves[line] = lines[line].move;
+        thread.root_lines = lines;
+
+        // A deeper iteration knows better, even when it scores its move lower.
+        stable_iterations = (depth > first_depth && moves[0] == best_move) ? stable_iterations + 1 : 0;
+        best_move = moves[0];
+        const int score = lines[0].score;
+        thread.root_pv = lines[0].pv;
+
+        thread.context.tt->store(data.hash(), value_to_tt(score, 0), depth, Bound::EXACT, best_move);
+
+        const std::uint64_t iteration_nodes = thread.nodes - nodes_before;
+        if (is_main && thread.context.on_iteration && *thread.context.on_iteration)
+        {
+            IterationReport report;
+            report.depth = depth;
+            report.time_ms = thread.context.time->elapsed();
+            report.nodes = thread.nodes;
+            report.hashfull = thread.context.tt->hashfull();
+            report.branching_factor = previous_iteration_nodes ? static_cast<double>(iteration_nodes) / previous_iteration_nodes : 0;
+            report.stats = thread.stats;
+            for (int line = 0; line < line_count; ++line)
+            {
+                report.multipv = line + 1;
+                report.score = lines[line].score;
+                report.mate_in = mate_in(lines[line].score);
+                report.best_move = lines[line].move;
+                report.pv = lines[line].pv;
+                (*thread.context.on_iteration)(report);
+            }
+        }
+        previous_iteration_nodes = iteration_nodes;
+
+        // Not enough time left to finish another iteration.
+        if (is_main && thread.context.time->soft_limit_reached(stable_iterations))
+            break;
+    }
+
+    return best_move;
+}
+
+/*
+Lazy SMP: every thread runs its own iterative deepening over its own board copy,
+and they cooperate only through the shared transposition table. The main thread
+decides the move; helpers are stopped as soon as it finishes.
+The context's stop flag may be raised from another thread to end the search early,
+even before it has started; it is lowered again on return.
+@param limits Depth, time and node limits, and the number of lines. The node budget is counted on the main thread.
+@param context Table, stop flag, clock and report callback the search uses.
+@param threads Number of search threads, at least 1.
+@param nodes If given, receives the node count summed over all threads.
+@param pv If given, receives the principal variation of the last completed iteration. */
+inline chess::Move find_best_move(chess::Board &data, const SearchLimits &limits, const SearchContext &context, int threads = 1,
+                                  std::uint64_t *nodes = nullptr, std::vector<chess::Move> *pv = nullptr)
+{
+    const int max_depth = std::clamp(limits.depth, 1, MAX_SEARCH_DEPTH);
+    context.time->start(limits, data.sideToMove());
+    context.tt->new_search();
+
+    std::vector<SearchThread> search_threads;
+    search_threads.reserve(std::max(threads, 1));
+    for (int i = 0; i < std::max(threads, 1); ++i)
+        search_threads.emplace_back(i, data, context);
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; ++i)
+        helpers.emplace_back([&search_threads, max_depth, i]
+                             { iterative_deepening(search_threads[i], max_depth); });
+
+    chess::Move best_move = iterative_deepening(search_threads[0], max_depth, limits.multipv);
+
+    context.stop->store(true);
+    for (std::thread &helper : helpers)
+        helper.join();
+    context.stop->store(false);
+
+    if (nodes)
+    {
+        *nodes = 0;
+        for (const SearchThread &thread : search_threads)
+            *nodes += thread.nodes;
+    }
+    if (pv)
+        *pv = search_threads[0].root_pv;
+    return best_move;
+}
+
+/// @brief The engine's search, with the global table, stop flag, clock and on_iteration.
+inline chess::Move find_best_move(chess::Board &data, const SearchLimits &limits, int threads = 1, std::uint64_t *nodes = nullptr,
+                                  std::vector<chess::Move> *pv = nullptr)
+{
+    return find_best_move(data, limits, SearchContext{}, threads, nodes, pv);
+}
+
+/// @brief Fixed depth search, see the SearchLimits overload. The search is always for the side to move.
+inline chess::Move find_best_move(chess::Board &data, int max_depth, chess::Color /*color*/, int threads = 1, std::uint64_t *nodes = nullptr)
+{
+    return find_best_move(data, SearchLimits::fixed_depth(max_depth), threads, nodes);
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SEARCH_STATS_HPP
+#define SEARCH_STATS_HPP
+
+#include "chess.hpp"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Build with -DNO_SEARCH_STATS to compile every counter increment out of the search.
+#ifdef NO_SEARCH_STATS
+constexpr bool SEARCH_STATS_ENABLED = false;
+#else
+constexpr bool SEARCH_STATS_ENABLED = true;
+#endif
+
+/*
+Counters one search thread keeps about its own work. Plain integers: each thread only
+ever touches its own copy, so there is nothing to synchronise. Nodes are not in here,
+the search counts those unconditionally for the node budget. */
+struct SearchStats
+{
+    std::uint64_t qnodes = 0;             // Nodes searched by quiescence search
+    std::uint64_t tt_probes = 0;
+    std::uint64_t tt_hits = 0;            // Probes that found the position
+    std::uint64_t tt_cutoffs = 0;         // Hits whose bound ended the node without a search
+    std::uint64_t beta_cutoffs = 0;
+    std::uint64_t first_move_cutoffs = 0; // Cut-offs on the first move searched, a measure of move ordering
+    std::uint64_t eval_calls = 0;
+    std::uint64_t lazy_evals = 0;         // Evaluations that stopped after the cheap terms, see evaluate_lazy()
+    std::uint64_t pawn_hash_hits = 0;     // Evaluations that found their pawn structure cached
+    std::uint64_t movegen_calls = 0;      // Full or partial legal move generations
+    std::uint64_t tb_hits = 0;            // Successful tablebase probes, in the search and at the root
+};
+
+/// @brief Increments a SearchStats counter, or does nothing if stats are compiled out.
+inline void count_stat(std::uint64_t &counter, std::uint64_t amount = 1)
+{
+    if constexpr (SEARCH_STATS_ENABLED)
+        counter += amount;
+}
+
+// What the main thread knows at the end of one iteration of iterative deepening.
+struct IterationReport
+{
+    int depth = 0;
+    int multipv = 1; // Rank of this line among the root moves searched (1 = best); one report per line
+    int score = 0;   // Centipawns, from the side to move's point of view
+    int mate_in = 0; // Moves to mate if the score is a mate score (negative: getting mated), else 0
+    chess::Move best_move = chess::Move::NO_MOVE;
+    std::vector<chess::Move> pv;
+    std::int64_t time_ms = 0;
+    std::uint64_t nodes = 0;
+    int hashfull = 0;
+    double branching_factor = 0; // Nodes of this iteration divided by nodes of the previous one
+    SearchStats stats;
+};
+
+// The move list as UCI move strings separated by spaces.
+inline std::string pv_to_uci(const std::vector<chess::Move> &pv)
+{
+    std::string line;
+    for (const chess::Move &move : pv)
+        line += (line.empty() ? "" : " ") + chess::uci::moveToUci(move);
+    return line;
+}
+
+inline std::uint64_t nodes_per_second(const IterationReport &report)
+{
+    return report.nodes * 1000 / static_cast<std::uint64_t>(report.time_ms > 0 ? report.time_ms : 1);
+}
+
+/// @brief Formats the report as UCI info lines: the standard one plus an "info string" with the counters.
+inline std::string to_uci_info(const IterationReport &report)
+{
+    std::ostringstream out;
+    out << "info depth " << report.depth << " multipv " << report.multipv;
+    if (report.mate_in)
+        out << " score mate " << report.mate_in;
+    else
+        out << " score cp " << report.score;
+    out << " nodes " << report.nodes << " nps " << nodes_per_second(report) << " time " << report.time_ms
+        << " hashfull " << report.hashfull;
+    if (report.stats.tb_hits)
+        out << " tbhits " << report.stats.tb_hits;
+    out << " pv " << pv_to_uci(report.pv);
+    // The counters are the same in every line of an iteration, so only the best line carries them.
+    if (SEARCH_STATS_ENABLED && report.multipv == 1)
+    {
+        const SearchStats &s = report.stats;
+        out << "\ninfo string stats qnodes " << s.qnodes << " tt_probes " << s.tt_probes << " tt_hits " << s.tt_hits
+            << " tt_cutoffs " << s.tt_cutoffs << " beta_cutoffs " << s.beta_cutoffs << " first_move_cutoffs " << s.first_move_cutoffs
+            << " eval_calls " << s.eval_calls << " lazy_evals " << s.lazy_evals << " pawn_hash_hits " << s.pawn_hash_hits << " movegen_calls " << s.movegen_calls << " tb_hits " << s.tb_hits << " branching_factor " << report.branching_factor;
+    }
+    return out.str();
+}
+
+/// @brief Formats the report as a single line JSON object, for log collection.
+inline std::string to_json(const IterationReport &report)
+{
+    std::ostringstream out;
+    out << "{\"depth\":" << report.depth << ",\"multipv\":" << report.multipv << ",\"score_cp\":" << report.score << ",\"mate_in\":" << report.mate_in
+        << ",\"best_move\":\"" << chess::uci::moveToUci(report.best_move) << "\",\"pv\":\"" << pv_to_uci(report.pv)
+        << "\",\"time_ms\":" << report.time_ms << ",\"nodes\":" << report.nodes
+        << ",\"nps\":" << nodes_per_second(report) << ",\"hashfull\":" << report.hashfull
+        << ",\"branching_factor\":" << report.branching_factor;
+    if constexpr (SEARCH_STATS_ENABLED)
+    {
+        const SearchStats &s = report.stats;
+        out << ",\"qnodes\":" << s.qnodes << ",\"tt_probes\":" << s.tt_probes << ",\"tt_hits\":" << s.tt_hits
+            << ",\"tt_cutoffs\":" << s.tt_cutoffs << ",\"beta_cutoffs\":" << s.beta_cutoffs
+            << ",\"first_move_cutoffs\":" << s.first_move_cutoffs << ",\"eval_calls\":" << s.eval_calls << ",\"lazy_evals\":" << s.lazy_evals
+            << ",\"pawn_hash_hits\":" << s.pawn_hash_hits << ",\"movegen_calls\":" << s.movegen_calls << ",\"tb_hits\":" << s.tb_hits;
+    }
+    out << '}';
+    return out.str();
+}
+
+#endif
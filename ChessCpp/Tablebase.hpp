@@ -0,0 +1,157 @@
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include "chess.hpp"
+
+#include <algorithm>
+#include <string>
+
+/*
+Syzygy endgame tablebases, through Fathom (https://github.com/jdart1/Fathom). Build with
+-DUSE_SYZYGY, Fathom's src directory on the include path, and tbprobe.c compiled and linked in:
+    gcc -O2 -c Fathom/src/tbprobe.c -o tbprobe.o
+    g++ -std=c++20 -O2 -pthread -DUSE_SYZYGY -IFathom/src -o uci uci.cpp tbprobe.o
+Fathom maps each table file the first time a position of that material is probed, so
+pointing the engine at a large set of tables costs nothing until an endgame is reached.
+Without USE_SYZYGY every probe misses and the engine plays as if it had no tables. */
+#ifdef USE_SYZYGY
+#include "tbprobe.h"
+constexpr bool SYZYGY_ENABLED = true;
+#else
+constexpr bool SYZYGY_ENABLED = false;
+#endif
+
+namespace Tablebase
+{
+    // Game theoretical value of a position for the side to move, with the fifty move rule.
+    enum class Wdl
+    {
+        LOSS,
+        BLESSED_LOSS, // Lost, but the fifty move rule saves it
+        DRAW,
+        CURSED_WIN,   // Won, but not within the fifty move rule
+        WIN
+    };
+
+    // Most pieces, kings included, of the tables found by init(). 0 means no tables.
+    inline int largest = 0;
+
+    /*
+    Loads the tables under path (several directories separated by ':' , or ';' on Windows).
+    An empty path or "<empty>" unloads them. Must not be called while a search is running.
+    @return Number of pieces of the largest tables found, 0 if none */
+    inline int init(const std::string &path)
+    {
+        largest = 0;
+#ifdef USE_SYZYGY
+        tb_free();
+        if (!path.empty() && path != "<empty>" && tb_init(path.c_str()))
+            largest = static_cast<int>(TB_LARGEST);
+#else
+        (void)path;
+#endif
+        return largest;
+    }
+
+    /// @brief True if the position may be in the tables: few enough pieces and no castling rights.
+    inline bool covers(const chess::Board &board)
+    {
+        return largest > 0 && board.occ().count() <= largest && board.castlingRights().isEmpty();
+    }
+
+#ifdef USE_SYZYGY
+    // Fathom takes the position as bitboards, with 0 standing for "no en passant square".
+    inline unsigned fathom_ep(const chess::Board &board)
+    {
+        const chess::Square ep = board.enpassantSq();
+        return ep == chess::Square::underlying::NO_SQ ? 0 : static_cast<unsigned>(ep.index());
+    }
+#endif
+
+    /*
+    Win/draw/loss probe for use inside the search. Only positions right after a capture or
+    pawn move (half move clock 0) are probed: their value is exact whatever the clock,
+    and every other position is one or more moves from such a position anyway.
+    @return false if the position is not in the tables */
+    inline bool probe_wdl(const chess::Board &board, Wdl &wdl)
+    {
+        if (!covers(board) || board.halfMoveClock() != 0)
+            return false;
+#ifdef USE_SYZYGY
+        using chess::PieceType;
+        const unsigned result = tb_probe_wdl(board.us(chess::Color::WHITE).getBits(), board.us(chess::Color::BLACK).getBits(),
+                                             board.pieces(PieceType::KING).getBits(), board.pieces(PieceType::QUEEN).getBits(),
+                                             board.pieces(PieceType::ROOK).getBits(), board.pieces(PieceType::BISHOP).getBits(),
+                                             board.pieces(PieceType::KNIGHT).getBits(), board.pieces(PieceType::PAWN).getBits(),
+                                             0, 0, fathom_ep(board), board.sideToMove() == chess::Color::WHITE);
+        if (result == TB_RESULT_FAILED)
+            return false;
+        wdl = static_cast<Wdl>(result);
+        return true;
+#else
+        (void)wdl;
+        return false;
+#endif
+    }
+
+    /*
+    Root filter: keeps only the root moves that hold the position's tablebase value, so the
+    search cannot throw away a win or walk into a loss the tables know about. Among winning
+    moves only those with the shortest distance to zeroing the clock (DTZ) stay, which makes
+    progress under the fifty move rule; when losing, those that resist the longest.
+    @param moves The legal root moves, filtered in place
+    @return false if the position is not in the tables, moves is then left alone */
+    inline bool filter_root_moves(const chess::Board &board, chess::Movelist &moves)
+    {
+        if (!covers(board))
+            return false;
+#ifdef USE_SYZYGY
+        using chess::PieceType;
+        unsigned results[TB_MAX_MOVES];
+        const unsigned root = tb_probe_root(board.us(chess::Color::WHITE).getBits(), board.us(chess::Color::BLACK).getBits(),
+                                            board.pieces(PieceType::KING).getBits(), board.pieces(PieceType::QUEEN).getBits(),
+                                            board.pieces(PieceType::ROOK).getBits(), board.pieces(PieceType::BISHOP).getBits(),
+                                            board.pieces(PieceType::KNIGHT).getBits(), board.pieces(PieceType::PAWN).getBits(),
+                                            board.halfMoveClock(), 0, fathom_ep(board), board.sideToMove() == chess::Color::WHITE, results);
+        if (root == TB_RESULT_FAILED || root == TB_RESULT_CHECKMATE || root == TB_RESULT_STALEMATE)
+            return false;
+
+        // Rank every move: a better result first, then the DTZ that serves it best.
+        auto rank = [](unsigned result)
+        {
+            const int wdl = static_cast<int>(TB_GET_WDL(result));
+            const int dtz = static_cast<int>(TB_GET_DTZ(result));
+            return wdl * 1024 + (wdl > static_cast<int>(Wdl::DRAW) ? -dtz : wdl < static_cast<int>(Wdl::DRAW) ? dtz : 0);
+        };
+        int best = -1 << 20;
+        for (int i = 0; results[i] != TB_RESULT_FAILED; ++i)
+            best = std::max(best, rank(results[i]));
+
+        chess::Movelist kept;
+        for (int i = 0; results[i] != TB_RESULT_FAILED; ++i)
+        {
+            if (rank(results[i]) != best)
+                continue;
+            const unsigned from = TB_GET_FROM(results[i]), to = TB_GET_TO(results[i]), promotes = TB_GET_PROMOTES(results[i]);
+            for (const chess::Move &move : moves)
+            {
+                if (move.from().index() != static_cast<int>(from) || move.to().index() != static_cast<int>(to))
+                    continue;
+                // Fathom numbers promotions queen 1, rook 2, bishop 3, knight 4.
+                const bool promotion = move.typeOf() == chess::Move::PROMOTION;
+                if (promotes ? promotion && static_cast<unsigned>(static_cast<int>(PieceType(PieceType::QUEEN)) - static_cast<int>(move.promotionType()) + 1) == promotes : !promotion)
+                    kept.add(move);
+            }
+        }
+        if (kept.empty())
+            return false;
+        moves = kept;
+        return true;
+#else
+        (void)moves;
+        return false;
+#endif
+    }
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef TIME_MANAGER_HPP
+#define TIME_MANAGER_HPP
+
+#include "chess.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+// Deepest iteration a search will start. Helper threads run until they are stopped.
+constexpr int MAX_SEARCH_DEPTH = 64;
+
+/*
+What a search is allowed to spend. Times are in milliseconds, -1 means "not given".
+With no time and no node limit the search runs until it has completed max depth. */
+struct SearchLimits
+{
+    std::int64_t movetime = -1;  // Exact time for this move
+    std::int64_t wtime = -1;     // Clock times
+    std::int64_t btime = -1;
+    std::int64_t winc = 0;       // Increments per move
+    std::int64_t binc = 0;
+    int movestogo = 0;           // Moves until the next time control, 0 if sudden death
+    std::uint64_t nodes = 0;     // Node budget, 0 if unlimited
+    int depth = MAX_SEARCH_DEPTH;
+    bool infinite = false;       // Search until told to stop, the other limits are ignored
+    int multipv = 1;             // Root moves searched to an exact score each iteration, best first
+
+    /// @brief Limits that only stop at a fixed depth.
+    static SearchLimits fixed_depth(int depth)
+    {
+        SearchLimits limits;
+        limits.depth = depth;
+        return limits;
+    }
+
+    /// @brief Limits that spend a fixed time on the move.
+    static SearchLimits fixed_time(std::int64_t movetime)
+    {
+        SearchLimits limits;
+        limits.movetime = movetime;
+        return limits;
+    }
+};
+
+/*
+Turns SearchLimits into deadlines for one search.
+    soft: checked between iterations. No new iteration starts after it, and it shrinks
+          while the best move stays the same from one iteration to the next.
+    hard: checked during the search. The running iteration is abandoned when it passes.
+Only the main search thread polls the clock, every POLL_INTERVAL nodes. */
+class TimeManager
+{
+public:
+    static constexpr std::uint64_t POLL_INTERVAL = 1024; // Power of two, the poll check is a mask
+    static constexpr std::int64_t MOVE_OVERHEAD = 20;    // Reserved for communication lag, in ms
+    static constexpr int DEFAULT_MOVES_TO_GO = 30;
+
+    /// @brief Starts the clock and computes the deadlines for a search in the given position.
+    void start(const SearchLimits &search_limits, chess::Color side)
+    {
+        limits = search_limits;
+        start_time = std::chrono::steady_clock::now();
+        soft_ms = hard_ms = -1;
+        if (limits.infinite)
+        {
+            limits = SearchLimits{};
+            limits.infinite = true;
+            return;
+        }
+
+        std::int64_t time_left = side == chess::Color::WHITE ? limits.wtime : limits.btime;
+        std::int64_t increment = side == chess::Color::WHITE ? limits.winc : limits.binc;
+
+        if (limits.movetime >= 0)
+        {
+            soft_ms = hard_ms = std::max<std::int64_t>(limits.movetime - MOVE_OVERHEAD, 1);
+        }
+        else if (time_left >= 0)
+        {
+            std::int64_t usable = std::max<std::int64_t>(time_left - MOVE_OVERHEAD, 1);
+            int moves_to_go = limits.movestogo > 0 ? std::min(limits.movestogo, DEFAULT_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+            soft_ms = std::min(usable / moves_to_go + increment * 3 / 4, usable);
+            // Never spend more than a third of what is left on one move. The increment only
+            // arrives once the move is played, so the clock itself is the last bound.
+            hard_ms = std::min({soft_ms * 4, usable / 3 + increment, usable});
+            soft_ms = std::min(soft_ms, hard_ms);
+        }
+    }
+
+    std::int64_t elapsed() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    int max_depth() const { return limits.depth; }
+
+    /// @brief The deadlines start() computed, in ms from the start, -1 if there is none.
+    std::int64_t soft_limit() const { return soft_ms; }
+    std::int64_t hard_limit() const { return hard_ms; }
+
+    /// @brief True once the running iteration must be abandoned.
+    /// @param nodes Nodes searched so far by the caller
+    bool hard_limit_reached(std::uint64_t nodes) const
+    {
+        if (limits.nodes && nodes >= limits.nodes)
+            return true;
+        return hard_ms >= 0 && elapsed() >= hard_ms;
+    }
+
+    /// @brief True if no new iteration should be started.
+    /// @param stable_iterations How many iterations in a row returned the same best move
+    bool soft_limit_reached(int stable_iterations) const
+    {
+        if (soft_ms < 0)
+            return false;
+        // A move that keeps coming back is unlikely to change, so it needs less confirmation.
+        std::int64_t soft = soft_ms;
+        if (stable_iterations >= 4)
+            soft = soft / 2;
+        else if (stable_iterations >= 2)
+            soft = soft * 3 / 4;
+        return elapsed() >= soft;
+    }
+
+private:
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    std::int64_t soft_ms = -1;
+    std::int64_t hard_ms = -1;
+};
+
+#endif
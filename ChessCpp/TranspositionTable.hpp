@@ -0,0 +1,224 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include "chess.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// How a stored value relates to the real value of the position.
+enum class Bound : std::uint8_t
+{
+    NONE,  // Empty slot
+    EXACT, // Value is the exact minimax value
+    LOWER, // Search failed high, the real value is at least this
+    UPPER  // Search failed low, the real value is at most this
+};
+
+/*
+A decoded copy of one transposition table slot.
+The full 64 bit hash is kept for verification, everything else is packed into one word:
+    bits  0-31: value
+    bits 32-47: best move
+    bits 48-55: depth
+    bits 56-57: bound
+    bits 58-63: generation (age) */
+struct TranspositionEntry
+{
+    std::uint64_t key = 0;
+    std::uint64_t data = 0;
+
+    static std::uint64_t pack(int value, int depth, Bound bound, chess::Move move, std::uint8_t generation)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::uint32_t>(value)) |
+               static_cast<std::uint64_t>(move.move()) << 32 |
+               static_cast<std::uint64_t>(static_cast<std::uint8_t>(depth)) << 48 |
+               static_cast<std::uint64_t>(static_cast<std::uint8_t>(bound) & 0x3) << 56 |
+               static_cast<std::uint64_t>(generation & 0x3F) << 58;
+    }
+
+    int value() const { return static_cast<std::int32_t>(data & 0xFFFFFFFF); }
+    chess::Move move() const { return chess::Move(static_cast<std::uint16_t>(data >> 32)); }
+    int depth() const { return static_cast<std::int8_t>(data >> 48); }
+    Bound bound() const { return static_cast<Bound>((data >> 56) & 0x3); }
+    std::uint8_t generation() const { return static_cast<std::uint8_t>(data >> 58); }
+};
+
+/*
+The slot as it lives in the shared table. Threads read and write it without locks:
+the key word is stored XORed with the data word, so a slot torn by two concurrent
+writers fails verification on probe instead of returning another position's data. */
+struct TranspositionSlot
+{
+    std::atomic<std::uint64_t> key{0};
+    std::atomic<std::uint64_t> data{0};
+
+    TranspositionEntry load() const
+    {
+        TranspositionEntry entry;
+        entry.data = data.load(std::memory_order_relaxed);
+        entry.key = key.load(std::memory_order_relaxed) ^ entry.data;
+        return entry;
+    }
+
+    void save(std::uint64_t hash, std::uint64_t packed)
+    {
+        key.store(hash ^ packed, std::memory_order_relaxed);
+        data.store(packed, std::memory_order_relaxed);
+    }
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared table needs lock-free 64 bit atomics");
+
+// Four entries share one cache line, so a probe touches exactly one line of memory.
+struct alignas(64) TranspositionBucket
+{
+    static constexpr int ENTRIES = 4;
+    TranspositionSlot entries[ENTRIES];
+};
+
+static_assert(sizeof(TranspositionBucket) == 64, "A bucket must fill exactly one cache line");
+
+/*
+Fixed-size transposition table. Memory use is decided once by resize() and never grows.
+Replacement prefers empty slots, then the slot with the shallowest depth, with entries
+from older searches treated as shallower than they are.
+probe() and store() may be called from any number of search threads at once;
+resize(), clear() and new_search() must only be called while no search is running. */
+class TranspositionTable
+{
+private:
+    std::unique_ptr<TranspositionBucket[]> buckets;
+    std::size_t bucket_count = 0;
+    std::uint64_t mask = 0; // Bucket count is a power of two, so indexing is a single AND.
+    std::uint8_t generation = 0;
+
+    TranspositionBucket &bucket(std::uint64_t hash) { return buckets[hash & mask]; }
+    const TranspositionBucket &bucket(std::uint64_t hash) const { return buckets[hash & mask]; }
+
+    // Age of an entry in searches, wraps at 64 like the generation field.
+    int age(const TranspositionEntry &entry) const
+    {
+        return (generation - entry.generation()) & 0x3F;
+    }
+
+public:
+    static constexpr std::size_t DEFAULT_SIZE_MB = 64;
+
+    explicit TranspositionTable(std::size_t size_mb = DEFAULT_SIZE_MB)
+    {
+        resize(size_mb);
+    }
+
+    /// @brief Reallocates the table. The size is rounded down to a power of two number of buckets.
+    /// @param size_mb Table size in megabytes, at least 1.
+    void resize(std::size_t size_mb)
+    {
+        if (size_mb < 1)
+            size_mb = 1;
+        std::size_t count = 1;
+        while (count * 2 * sizeof(TranspositionBucket) <= size_mb * 1024 * 1024)
+            count *= 2;
+
+        buckets.reset(); // Free the old table before allocating the new one.
+        buckets = std::make_unique<TranspositionBucket[]>(count);
+        bucket_count = count;
+        mask = count - 1;
+        generation = 0;
+    }
+
+    /// @brief Wipes every entry without reallocating.
+    void clear()
+    {
+        for (std::size_t i = 0; i < bucket_count; ++i)
+            for (TranspositionSlot &slot : buckets[i].entries)
+                slot.save(0, 0);
+        generation = 0;
+    }
+
+    /// @brief Called once per root search so entries from earlier searches age out.
+    void new_search()
+    {
+        generation = (generation + 1) & 0x3F;
+    }
+
+    /// @brief Looks up a position.
+    /// @param hash Zobrist key of the position
+    /// @param entry Filled with the stored entry on a hit
+    /// @return true if the position was found
+    bool probe(std::uint64_t hash, TranspositionEntry &entry) const
+    {
+        const TranspositionBucket &b = bucket(hash);
+        for (const TranspositionSlot &slot : b.entries)
+        {
+            TranspositionEntry e = slot.load();
+            if (e.key == hash && e.bound() != Bound::NONE)
+            {
+                entry = e;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Stores a search result, choosing which slot of the bucket to overwrite.
+    void store(std::uint64_t hash, int value, int depth, Bound bound, chess::Move move)
+    {
+        TranspositionBucket &b = bucket(hash);
+        TranspositionSlot *replace = &b.entries[0];
+        TranspositionEntry old = replace->load();
+
+        for (TranspositionSlot &slot : b.entries)
+        {
+            TranspositionEntry e = slot.load();
+            if (e.key == hash || e.bound() == Bound::NONE)
+            {
+                replace = &slot;
+                old = e;
+                break;
+            }
+            // Older entries count as 8 plies shallower per search they have survived.
+            if (e.depth() - 8 * age(e) < old.depth() - 8 * age(old))
+            {
+                replace = &slot;
+                old = e;
+            }
+        }
+
+        // Keep a deeper result for the same position from this search, unless the new one is exact.
+        if (old.key == hash && old.bound() != Bound::NONE && bound != Bound::EXACT &&
+            age(old) == 0 && depth < old.depth())
+            return;
+
+        // A fail-low has no best move, so keep the one we already knew about.
+        if (move == chess::Move::NO_MOVE && old.key == hash)
+            move = old.move();
+
+        replace->save(hash, TranspositionEntry::pack(value, depth, bound, move, generation));
+    }
+
+    /// @brief Per-mille estimate of how full the table is with entries from the current search.
+    int hashfull() const
+    {
+        int used = 0;
+        int sampled = 0;
+        for (std::size_t i = 0; i < bucket_count && sampled < 1000; ++i)
+        {
+            for (const TranspositionSlot &slot : buckets[i].entries)
+            {
+                TranspositionEntry e = slot.load();
+                if (e.bound() != Bound::NONE && age(e) == 0)
+                    ++used;
+                ++sampled;
+            }
+        }
+        return sampled ? used * 1000 / sampled : 0;
+    }
+
+    std::size_t size_mb() const
+    {
+        return bucket_count * sizeof(TranspositionBucket) / (1024 * 1024);
+    }
+};
+
+#endif
@@ -0,0 +1,397 @@
+#include "chess.hpp"
+#include "Eval.hpp"
+#include "PositionRecord.hpp"
+#include "Search.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Batch analysis: searches every position of a file and prints one JSON line per position.
+
+    analyze <positions.epd|games.pgn|positions.pos> [depth] [threads] [hash_mb] [nodes] [multipv]
+
+EPD and FEN lines are read as they are (an EPD "id" is passed through), PGN games give
+every position reached in the game, and .pos files are binary position records (see
+PositionRecord.hpp). Lines go to stdout in input order, progress and totals to stderr.
+With multipv > 1 each line also lists the best multipv root moves, each with its score and PV.
+
+Every worker thread runs its own single-threaded search with its own board, move ordering
+heuristics, pawn hash, clock and a slice (hash_mb / threads) of the hash, so the workers
+never wait on each other. A reader thread feeds them through a bounded window: it may run
+at most WINDOW_PER_THREAD positions per worker ahead of the output, so a slow consumer of
+stdout stalls the reader instead of letting queued work grow, whatever the input size. */
+
+constexpr std::size_t WINDOW_PER_THREAD = 64;
+
+struct AnalysisJob
+{
+    std::uint64_t index = 0;
+    PositionRecord position;
+    std::string source; // JSON fields saying where the position came from, each with a leading comma
+};
+
+/*
+The positions between the reader, the workers and the writer. Jobs are handed out in input
+order to whichever worker asks first, which balances the load between workers without any
+stealing: the jobs are independent and cost the same to hand out. Results are put back in
+input order before they are written. */
+class AnalysisPipeline
+{
+public:
+    explicit AnalysisPipeline(std::size_t window) : window(std::max<std::size_t>(window, 1)) {}
+
+    /// @brief Queues a position. Blocks while the window between input and output is full.
+    void push(AnalysisJob job)
+    {
+        std::unique_lock lock(mutex);
+        space.wait(lock, [&] { return pushed - written < window; });
+        job.index = pushed++;
+        jobs.push_back(std::move(job));
+        work.notify_one();
+    }
+
+    /// @brief Marks the end of the input.
+    void close()
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+        work.notify_all();
+        ready.notify_all();
+    }
+
+    /// @brief Takes the next position. Returns false once the input is closed and drained.
+    bool pop(AnalysisJob &job)
+    {
+        std::unique_lock lock(mutex);
+        work.wait(lock, [&] { return !jobs.empty() || closed; });
+        if (jobs.empty())
+            return false;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        return true;
+    }
+
+    void finish(std::uint64_t index, std::string line)
+    {
+        std::lock_guard lock(mutex);
+        finished.emplace(index, std::move(line));
+        if (index == written)
+            ready.notify_one();
+    }
+
+    /// @brief Waits for the next line in input order. Returns false once every position has been written.
+    bool next_line(std::string &line)
+    {
+        std::unique_lock lock(mutex);
+        ready.wait(lock, [&] { return finished.count(written) || (closed && written == pushed); });
+        auto next = finished.find(written);
+        if (next == finished.end())
+            return false;
+        line = std::move(next->second);
+        finished.erase(next);
+        ++written;
+        space.notify_one();
+        return true;
+    }
+
+private:
+    const std::size_t window;
+    std::mutex mutex;
+    std::condition_variable space, work, ready;
+    std::deque<AnalysisJob> jobs;
+    std::map<std::uint64_t, std::string> finished; // At most window entries
+    std::uint64_t pushed = 0;
+    std::uint64_t written = 0;
+    bool closed = false;
+};
+
+std::string json_string(std::string_view text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            quoted += c;
+    }
+    return quoted + '"';
+}
+
+// The quoted operand of an EPD opcode, e.g. id "WAC.001";
+std::string epd_operand(const std::string &line, const std::string &opcode)
+{
+    std::size_t at = line.find(' ' + opcode + " \"");
+    if (at == std::string::npos)
+        return "";
+    std::size_t begin = at + opcode.size() + 3;
+    std::size_t end = line.find('"', begin);
+    return end == std::string::npos ? "" : line.substr(begin, end - begin);
+}
+
+bool is_number(const std::string &text)
+{
+    return !text.empty() && std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+// Queues every position reached in each game. Positions are analysed without the game's history.
+class AnalysisVisitor : public chess::pgn::Visitor
+{
+public:
+    explicit AnalysisVisitor(AnalysisPipeline &pipeline) : pipeline(pipeline) {}
+
+    void startPgn() override
+    {
+        board.setFen(chess::constants::STARTPOS);
+        ply = 0;
+        broken = false;
+        ++games;
+    }
+
+    void header(std::string_view key, std::string_view value) override
+    {
+        if (key == "FEN")
+            board.setFen(value);
+    }
+
+    void startMoves() override
+    {
+        add();
+    }
+
+    void move(std::string_view san, std::string_view) override
+    {
+        if (broken)
+            return;
+        chess::Move move = chess::Move::NO_MOVE;
+        try
+        {
+            move = chess::uci::parseSan(board, san);
+        }
+        catch (const std::exception &)
+        {
+        }
+        if (move == chess::Move::NO_MOVE)
+        {
+            broken = true; // Keep the positions before the bad move, drop the rest of the game
+            return;
+        }
+        board.makeMove(move);
+        ++ply;
+        add();
+    }
+
+    void endPgn() override {}
+
+private:
+    AnalysisPipeline &pipeline;
+    chess::Board board;
+    std::uint64_t games = 0;
+    int ply = 0;
+    bool broken = false;
+
+    void add()
+    {
+        pipeline.push({0, PositionRecord::from_board(board), ",\"game\":" + std::to_string(games) + ",\"ply\":" + std::to_string(ply)});
+    }
+};
+
+// Queues every position of the input. Returns false if the input cannot be read.
+bool read_input(const std::string &input_path, AnalysisPipeline &pipeline)
+{
+    if (input_path.ends_with(".pos"))
+    {
+        PositionFile file(input_path);
+        if (file.records().empty())
+            return false;
+        for (const PositionRecord &record : file.records())
+            pipeline.push({0, record, ""});
+        return true;
+    }
+
+    std::ifstream input(input_path, std::ios::binary);
+    if (!input)
+        return false;
+    if (input_path.ends_with(".pgn"))
+    {
+        AnalysisVisitor visitor(pipeline);
+        chess::pgn::StreamParser parser(input);
+        parser.readGames(visitor);
+        return true;
+    }
+
+    // EPD or FEN, one position per line. The move counters are taken when the line has them.
+    std::string line;
+    chess::Board board;
+    std::uint64_t line_number = 0;
+    while (std::getline(input, line))
+    {
+        ++line_number;
+        std::istringstream fields(line);
+        std::vector<std::string> parts;
+        std::string field;
+        while (parts.size() < 6 && fields >> field)
+            parts.push_back(field);
+        if (parts.size() < 4 || parts[0][0] == '#')
+            continue;
+
+        std::string fen = parts[0] + ' ' + parts[1] + ' ' + parts[2] + ' ' + parts[3];
+        fen += parts.size() == 6 && is_number(parts[4]) && is_number(parts[5]) ? ' ' + parts[4] + ' ' + parts[5] : " 0 1";
+        board.setFen(fen);
+
+        std::string source = ",\"line\":" + std::to_string(line_number);
+        const std::string id = epd_operand(line, "id");
+        if (!id.empty())
+            source += ",\"id\":" + json_string(id);
+        pipeline.push({0, PositionRecord::from_board(board), source});
+    }
+    return true;
+}
+
+// Totals over all workers, for the summary.
+struct AnalysisTotals
+{
+    std::atomic<std::uint64_t> positions{0};
+    std::atomic<std::uint64_t> nodes{0};
+};
+
+std::string analysis_line(const AnalysisJob &job, const chess::Board &board, chess::Move best_move, const std::vector<IterationReport> &lines,
+                          std::uint64_t nodes, std::int64_t time_ms)
+{
+    const IterationReport report = lines.empty() ? IterationReport{} : lines[0];
+    std::ostringstream out;
+    out << "{\"index\":" << job.index << job.source << ",\"fen\":" << json_string(board.getFen());
+
+    if (best_move == chess::Move::NO_MOVE)
+    {
+        out << ",\"best_move\":null,\"game_over\":\"" << (board.inCheck() ? "checkmate" : "stalemate") << "\"}";
+        return out.str();
+    }
+
+    out << ",\"best_move\":\"" << chess::uci::moveToUci(best_move) << '"';
+    if (report.best_move == chess::Move::NO_MOVE)
+    {
+        // No iteration finished, so the score is the static eval. A forced move is played without
+        // searching; otherwise the limits stopped depth 1 early and the nodes it took are still reported.
+        chess::Movelist moves;
+        chess::movegen::legalmoves(moves, board);
+        const bool forced = moves.size() == 1;
+        const int eval = Evaluation(board, chess::Color::WHITE).evaluate();
+        out << ",\"score_cp\":" << (board.sideToMove() == chess::Color::WHITE ? eval : -eval) << ",\"mate_in\":0,\"depth\":0,\"nodes\":"
+            << (forced ? 0 : nodes) << ",\"time_ms\":" << (forced ? 0 : time_ms) << ",\"pv\":\"" << chess::uci::moveToUci(best_move) << "\"}";
+        return out.str();
+    }
+    out << ",\"score_cp\":" << report.score << ",\"mate_in\":" << report.mate_in << ",\"depth\":" << report.depth
+        << ",\"nodes\":" << nodes << ",\"time_ms\":" << report.time_ms << ",\"pv\":\"" << pv_to_uci(report.pv) << '"';
+    if (lines.size() > 1)
+    {
+        out << ",\"lines\":[";
+        for (const IterationReport &line : lines)
+            out << (line.multipv > 1 ? "," : "") << "{\"move\":\"" << chess::uci::moveToUci(line.best_move) << "\",\"score_cp\":" << line.score
+                << ",\"mate_in\":" << line.mate_in << ",\"pv\":\"" << pv_to_uci(line.pv) << "\"}";
+        out << ']';
+    }
+    out << '}';
+    return out.str();
+}
+
+// One worker: an independent single-threaded search per position until the input runs dry.
+void analysis_worker(AnalysisPipeline &pipeline, const SearchLimits &limits, std::size_t hash_mb, AnalysisTotals &totals)
+{
+    TranspositionTable table(hash_mb);
+    std::atomic<bool> stop{false};
+    TimeManager clock;
+    // The lines of the last completed iteration, best first. The best line starts each iteration's reports.
+    std::vector<IterationReport> last_lines;
+    const std::function<void(const IterationReport &)> keep_report = [&](const IterationReport &report)
+    {
+        if (report.multipv == 1)
+            last_lines.clear();
+        last_lines.push_back(report);
+    };
+    const SearchContext context{&table, &stop, &clock, &keep_report};
+
+    EvalBoard board;
+    AnalysisJob job;
+    while (pipeline.pop(job))
+    {
+        board.load(job.position);
+        last_lines.clear();
+        std::uint64_t nodes = 0;
+        const chess::Move best_move = find_best_move(board, limits, context, 1, &nodes);
+        pipeline.finish(job.index, analysis_line(job, board, best_move, last_lines, nodes, clock.elapsed()));
+        totals.positions.fetch_add(1, std::memory_order_relaxed);
+        totals.nodes.fetch_add(nodes, std::memory_order_relaxed);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: analyze <positions.epd|games.pgn|positions.pos> [depth] [threads] [hash_mb] [nodes] [multipv]\n";
+        return EXIT_FAILURE;
+    }
+    auto arg = [&](int index, long long fallback)
+    { return argc > index ? std::stoll(argv[index]) : fallback; };
+
+    SearchLimits limits = SearchLimits::fixed_depth(static_cast<int>(arg(2, 8)));
+    const int threads = static_cast<int>(std::max<long long>(arg(3, std::max(std::thread::hardware_concurrency(), 1u)), 1));
+    const std::size_t hash_mb = static_cast<std::size_t>(std::max<long long>(arg(4, TranspositionTable::DEFAULT_SIZE_MB) / threads, 1));
+    limits.nodes = static_cast<std::uint64_t>(arg(5, 0));
+    limits.multipv = static_cast<int>(std::clamp<long long>(arg(6, 1), 1, MAX_MULTIPV));
+
+    AnalysisPipeline pipeline(WINDOW_PER_THREAD * threads);
+    AnalysisTotals totals;
+    const auto start = std::chrono::steady_clock::now();
+
+    bool readable = true;
+    std::thread reader([&]
+                       {
+                           readable = read_input(argv[1], pipeline);
+                           pipeline.close();
+                       });
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back(analysis_worker, std::ref(pipeline), std::cref(limits), hash_mb, std::ref(totals));
+
+    std::string line;
+    std::uint64_t written = 0;
+    while (pipeline.next_line(line))
+    {
+        std::cout << line << '\n' << std::flush;
+        if (++written % 1000 == 0)
+            std::cerr << written << " positions\r" << std::flush;
+    }
+
+    reader.join();
+    for (std::thread &worker : workers)
+        worker.join();
+    if (!readable)
+    {
+        std::cerr << "Cannot read " << argv[1] << '\n';
+        return EXIT_FAILURE;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const std::uint64_t positions = totals.positions.load(), nodes = totals.nodes.load();
+    std::cerr << positions << " positions in " << seconds << " s with " << threads << " threads, "
+              << static_cast<std::uint64_t>(positions / std::max(seconds, 1e-9)) << " positions/sec, "
+              << static_cast<std::uint64_t>(nodes / std::max(seconds, 1e-9)) << " nps\n";
+    return EXIT_SUCCESS;
+}
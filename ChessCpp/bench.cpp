@@ -0,0 +1,624 @@
+#include "chess.hpp"
+#include "BatchEval.hpp"
+#include "Eval.hpp"
+#include "GameLog.hpp"
+#include "PositionRecord.hpp"
+#include "Search.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed positions so numbers are comparable between runs and machines.
+const std::vector<std::string> BENCH_FENS = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+// Perft positions with their published node counts (chessprogramming.org "Perft Results").
+// expected[d - 1] is the count at depth d; the last one is the depth the case runs at in full.
+struct PerftCase
+{
+    std::string fen;
+    std::vector<std::uint64_t> expected;
+
+    int depth() const { return static_cast<int>(expected.size()); }
+};
+
+const std::vector<PerftCase> PERFT_CASES = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", {20, 400, 8902, 197281, 4865609}},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", {48, 2039, 97862, 4085603}},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", {14, 191, 2812, 43238, 674624}},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", {44, 1486, 62379, 2103487}},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", {46, 2079, 89890, 3894594}},
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Counts the leaf nodes of the legal move tree. The last ply is counted without making the moves.
+std::uint64_t perft(chess::Board &board, int depth)
+{
+    chess::Movelist moves;
+    chess::movegen::legalmoves(moves, board);
+    if (depth <= 1)
+        return depth == 1 ? moves.size() : 1;
+
+    std::uint64_t nodes = 0;
+    for (const chess::Move &move : moves)
+    {
+        board.makeMove(move);
+        nodes += perft(board, depth - 1);
+        board.unmakeMove(move);
+    }
+    return nodes;
+}
+
+/*
+Runs every perft case and checks it against the known count.
+@param max_depth Caps the depth of every case, 0 runs them at full depth.
+@return true if every count matched */
+bool bench_perft(int max_depth)
+{
+    std::cout << "Perft\n";
+    bool all_passed = true;
+    std::uint64_t total_nodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const PerftCase &test : PERFT_CASES)
+    {
+        chess::Board board(test.fen);
+        const int depth = max_depth > 0 ? std::min(test.depth(), max_depth) : test.depth();
+        std::uint64_t nodes = perft(board, depth);
+        total_nodes += nodes;
+
+        const std::uint64_t expected = test.expected[depth - 1];
+        std::string verdict = nodes == expected ? "  ok" : "  FAILED, expected " + std::to_string(expected);
+        all_passed = all_passed && nodes == expected;
+        std::cout << "  depth " << depth << std::setw(12) << nodes << verdict << "  " << test.fen << '\n';
+    }
+    double seconds = seconds_since(start);
+    std::cout << "  " << total_nodes << " nodes, " << static_cast<std::uint64_t>(total_nodes / std::max(seconds, 1e-9)) << " nps\n\n";
+    return all_passed;
+}
+
+// Clocks the time manager must stay inside: nearly empty clocks with large increments first.
+struct ClockCase
+{
+    std::int64_t time_left;
+    std::int64_t increment;
+    int moves_to_go;
+};
+
+const std::vector<ClockCase> CLOCK_CASES = {
+    {50, 100, 0},
+    {120, 1000, 0},
+    {1, 5000, 0},
+    {25, 0, 0},
+    {500, 30000, 1},
+    {2000, 2000, 0},
+    {60000, 1000, 0},
+    {300000, 0, 40},
+};
+
+/*
+Checks the deadlines of every clock case: neither may be past the time left on the clock,
+less the move overhead, since the increment only arrives after the move.
+@return true if every case stayed inside its clock */
+bool bench_time_manager()
+{
+    std::cout << "Time manager\n";
+    bool all_passed = true;
+    for (const ClockCase &clock : CLOCK_CASES)
+    {
+        SearchLimits limits;
+        limits.wtime = clock.time_left;
+        limits.winc = clock.increment;
+        limits.movestogo = clock.moves_to_go;
+        TimeManager time_manager;
+        time_manager.start(limits, chess::Color::WHITE);
+
+        const std::int64_t usable = std::max<std::int64_t>(clock.time_left - TimeManager::MOVE_OVERHEAD, 1);
+        const bool passed = time_manager.soft_limit() >= 0 && time_manager.soft_limit() <= time_manager.hard_limit() &&
+                            time_manager.hard_limit() <= usable;
+        all_passed = all_passed && passed;
+        std::cout << "  time " << std::setw(6) << clock.time_left << " inc " << std::setw(5) << clock.increment << " mtg " << std::setw(2)
+                  << clock.moves_to_go << "  soft " << std::setw(5) << time_manager.soft_limit() << " hard " << std::setw(5)
+                  << time_manager.hard_limit() << (passed ? "  ok" : "  FAILED, more than " + std::to_string(usable)) << '\n';
+    }
+    std::cout << '\n';
+    return all_passed;
+}
+
+// Measures static_eval throughput over the bench positions. Prints a checksum so the work is not optimised away.
+void bench_eval(int rounds)
+{
+    std::vector<chess::Board> boards(BENCH_FENS.begin(), BENCH_FENS.end());
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const chess::Board &board : boards)
+            checksum += Evaluation(board, board.sideToMove()).static_eval();
+    double seconds = seconds_since(start);
+    std::uint64_t evals = static_cast<std::uint64_t>(rounds) * boards.size();
+
+    std::cout << "Static eval\n";
+    std::cout << "  " << evals << " evals in " << std::fixed << std::setprecision(3) << seconds << " s, "
+              << static_cast<std::uint64_t>(evals / std::max(seconds, 1e-9)) << " evals/sec (checksum " << checksum << ")\n\n";
+}
+
+// Every position two plies from the bench positions, a few thousand varied boards.
+std::vector<chess::Board> two_ply_positions()
+{
+    std::vector<chess::Board> boards;
+    for (const std::string &fen : BENCH_FENS)
+    {
+        chess::Board board(fen);
+        chess::Movelist moves, replies;
+        chess::movegen::legalmoves(moves, board);
+        for (const chess::Move &move : moves)
+        {
+            board.makeMove(move);
+            chess::movegen::legalmoves(replies, board);
+            for (const chess::Move &reply : replies)
+            {
+                board.makeMove(reply);
+                boards.push_back(board);
+                board.unmakeMove(reply);
+            }
+            board.unmakeMove(move);
+        }
+    }
+    return boards;
+}
+
+/*
+Batched against one-at-a-time evaluation over every position two plies from the bench
+positions. The two must agree exactly; returns false if any score differs. */
+bool bench_batch_eval(int rounds)
+{
+    const std::vector<chess::Board> boards = two_ply_positions();
+    std::vector<int> single(boards.size()), uncached(boards.size()), batch(boards.size());
+    auto one_at_a_time = [&]
+    {
+        for (std::size_t i = 0; i < boards.size(); ++i)
+            single[i] = Evaluation(boards[i], chess::Color::WHITE).evaluate();
+    };
+    // What one-at-a-time costs when the pawn hash misses, as it mostly does over a tuning set.
+    auto without_pawn_hash = [&]
+    {
+        for (std::size_t i = 0; i < boards.size(); ++i)
+        {
+            Bitboard white_pawns = boards[i].pieces(PieceType::PAWN, chess::Color::WHITE);
+            Bitboard black_pawns = boards[i].pieces(PieceType::PAWN, chess::Color::BLACK);
+            uncached[i] = Evaluation(boards[i], chess::Color::WHITE).evaluate_with_pawn_structure(Evaluation::pawn_structure_score(white_pawns, black_pawns));
+        }
+    };
+    auto batched = [&] { BatchEval::evaluate_batch(boards, batch); };
+
+    // One untimed pass of each first, so the one timed first does not also pay for warming up
+    // the caches, the pawn hash and the clock speed.
+    one_at_a_time();
+    without_pawn_hash();
+    batched();
+    auto timed = [&](auto &pass)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round)
+            pass();
+        return seconds_since(start);
+    };
+    const double single_seconds = timed(one_at_a_time);
+    const double uncached_seconds = timed(without_pawn_hash);
+    const double batch_seconds = timed(batched);
+
+    const bool identical = single == batch && uncached == batch;
+    std::uint64_t evals = static_cast<std::uint64_t>(rounds) * boards.size();
+    std::cout << "Batch eval, " << boards.size() << " positions, ";
+    if constexpr (BatchEval::Lanes::WIDTH == 1)
+        std::cout << "scalar, no lane kernel\n";
+    else
+        std::cout << BatchEval::Lanes::WIDTH << " lane kernel\n";
+    std::cout << "  one at a time:               " << static_cast<std::uint64_t>(evals / std::max(single_seconds, 1e-9)) << " evals/sec\n";
+    std::cout << "  one at a time, no pawn hash: " << static_cast<std::uint64_t>(evals / std::max(uncached_seconds, 1e-9)) << " evals/sec\n";
+    std::cout << "  batched:                     " << static_cast<std::uint64_t>(evals / std::max(batch_seconds, 1e-9)) << " evals/sec\n";
+    std::cout << "  " << (identical ? "scores identical" : "SCORES DIFFER") << "\n\n";
+    return identical;
+}
+
+/*
+Setting up positions from FEN strings against loading them from binary position records.
+Every loaded board must match its FEN twin (FEN, hash and evaluation); returns false if not. */
+bool bench_records(int rounds)
+{
+    const std::vector<chess::Board> boards = two_ply_positions();
+    std::vector<std::string> fens;
+    std::vector<PositionRecord> records;
+    for (const chess::Board &board : boards)
+    {
+        fens.push_back(board.getFen());
+        records.push_back(PositionRecord::from_board(board));
+    }
+
+    EvalBoard board;
+    std::uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const std::string &fen : fens)
+        {
+            board.setFen(fen);
+            checksum += board.hash();
+        }
+    double fen_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const PositionRecord &record : records)
+        {
+            board.load(record);
+            checksum -= board.hash();
+        }
+    double record_seconds = seconds_since(start);
+
+    bool identical = checksum == 0;
+    EvalBoard from_fen;
+    for (std::size_t i = 0; i < records.size() && identical; ++i)
+    {
+        from_fen.setFen(fens[i]);
+        board.load(records[i]);
+        identical = board.getFen() == fens[i] && board.hash() == from_fen.hash() &&
+                    Evaluation(board, chess::Color::WHITE).evaluate() == Evaluation(from_fen, chess::Color::WHITE).evaluate();
+    }
+
+    std::uint64_t loads = static_cast<std::uint64_t>(rounds) * records.size();
+    std::cout << "Position records, " << records.size() << " positions, " << sizeof(PositionRecord) << " bytes each\n";
+    std::cout << "  from FEN:    " << static_cast<std::uint64_t>(loads / std::max(fen_seconds, 1e-9)) << " boards/sec\n";
+    std::cout << "  from record: " << static_cast<std::uint64_t>(loads / std::max(record_seconds, 1e-9)) << " boards/sec\n";
+    std::cout << "  " << (identical ? "boards identical" : "BOARDS DIFFER") << "\n\n";
+    return identical;
+}
+
+/*
+Logs random games from several threads to a PGN GameLog, destroys the log right after the
+last game ends, and checks that every game is in the file. A PGN game is only written at its
+end record, so a record left in the queue at shutdown loses a whole game.
+@return false if a game is missing */
+bool bench_game_log(int rounds)
+{
+    constexpr int THREADS = 8, GAMES_PER_THREAD = 25;
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_game_log.pgn").string();
+    bool complete = true;
+    std::uint64_t moves = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds && complete; ++round)
+    {
+        {
+            GameLog log(path, LogLevel::MOVES, LogFormat::PGN);
+            std::vector<std::thread> threads;
+            std::vector<std::uint64_t> played(THREADS);
+            for (int t = 0; t < THREADS; ++t)
+                threads.emplace_back([&, t]
+                                     {
+                    std::mt19937 random(round * THREADS + t);
+                    for (int game = 0; game < GAMES_PER_THREAD; ++game)
+                    {
+                        chess::Board board;
+                        const std::uint32_t id = log.start_game(board);
+                        for (int ply = 0; ply < 100 && board.isGameOver().first == chess::GameResultReason::NONE; ++ply)
+                        {
+                            chess::Movelist legal;
+                            chess::movegen::legalmoves(legal, board);
+                            const chess::Move move = legal[random() % legal.size()];
+                            log.log_move(id, board, move);
+                            board.makeMove(move);
+                            ++played[t];
+                        }
+                        log.end_game(id, board);
+                    } });
+            for (std::thread &thread : threads)
+                thread.join();
+            for (std::uint64_t count : played)
+                moves += count;
+        }
+
+        // Every game number from 1 up is in the file exactly once.
+        std::vector<int> seen(THREADS * GAMES_PER_THREAD + 1, 0);
+        std::ifstream input(path);
+        std::string line;
+        while (std::getline(input, line))
+            if (line.starts_with("[Event \"Game "))
+            {
+                const int game = std::stoi(line.substr(13));
+                if (game > 0 && game < static_cast<int>(seen.size()))
+                    ++seen[game];
+            }
+        complete = std::all_of(seen.begin() + 1, seen.end(), [](int count) { return count == 1; });
+    }
+    const double seconds = seconds_since(start);
+    std::remove(path.c_str());
+
+    std::cout << "Game log, " << THREADS << " threads, " << rounds << " logs of " << THREADS * GAMES_PER_THREAD << " games\n";
+    std::cout << "  " << static_cast<std::uint64_t>(moves / std::max(seconds, 1e-9)) << " moves/sec logged and written\n";
+    std::cout << "  " << (complete ? "every game written" : "GAMES MISSING") << "\n\n";
+    return complete;
+}
+
+/*
+Fixed-depth, single-threaded search of every bench position from an empty table.
+The total node count is deterministic for a given engine version, so it serves as a
+signature: a change that is meant to leave the search alone must leave it unchanged. */
+std::uint64_t bench_search(int depth)
+{
+    std::cout << "Search, depth " << depth << '\n';
+    std::uint64_t total_nodes = 0, eval_calls = 0, lazy_evals = 0;
+    double total_seconds = 0;
+    pawn_hash_table.clear();
+    SearchStats stats;
+    on_iteration = [&stats](const IterationReport &report) { stats = report.stats; };
+    for (const std::string &fen : BENCH_FENS)
+    {
+        transposition_table.clear();
+        chess::Board board(fen);
+        std::uint64_t nodes = 0;
+        stats = SearchStats{};
+        auto start = std::chrono::steady_clock::now();
+        chess::Move best_move = find_best_move(board, SearchLimits::fixed_depth(depth), 1, &nodes);
+        total_seconds += seconds_since(start);
+        total_nodes += nodes;
+        eval_calls += stats.eval_calls;
+        lazy_evals += stats.lazy_evals;
+        std::cout << "  " << std::setw(6) << chess::uci::moveToUci(best_move) << std::setw(12) << nodes << "  " << fen << '\n';
+    }
+    std::cout << "  Total time (s): " << std::fixed << std::setprecision(3) << total_seconds << '\n';
+    std::cout << "  Nodes per second: " << static_cast<std::uint64_t>(total_nodes / std::max(total_seconds, 1e-9)) << '\n';
+    std::cout << "  Pawn hash hit rate: " << std::setprecision(1) << 100 * pawn_hash_table.hit_rate() << "%\n";
+    if constexpr (SEARCH_STATS_ENABLED)
+        std::cout << "  Lazy eval exits: " << 100.0 * lazy_evals / std::max<std::uint64_t>(eval_calls, 1) << "% of " << eval_calls << " evals\n";
+    std::cout << "  Nodes signature: " << total_nodes << "\n\n";
+    on_iteration = nullptr;
+    return total_nodes;
+}
+
+// Checks at every node of the move tree below board that the NNUE accumulator it kept through makeMove/unmakeMove matches a recount.
+bool nnue_accumulators_match(EvalBoard &board, int depth)
+{
+    Nnue::Accumulator recount;
+    recount.refresh(board);
+    if (!(recount == board.nnue_accumulator()))
+    {
+        std::cout << "  MISMATCH in " << board.getFen() << '\n';
+        return false;
+    }
+    if (depth == 0)
+        return true;
+
+    chess::Movelist moves;
+    chess::movegen::legalmoves(moves, board);
+    for (const chess::Move &move : moves)
+    {
+        board.makeMove(move);
+        const bool match = nnue_accumulators_match(board, depth - 1);
+        board.unmakeMove(move);
+        if (!match)
+            return false;
+    }
+    return true;
+}
+
+/*
+The NNUE backend with the network at path. Checks the incrementally updated accumulators
+against recounts over a depth 3 tree below each bench position, then times the network's
+evaluation (the output layer), a make/unmake pair with the accumulator updates, and a cold
+refresh, and finally runs the search benchmark on the network.
+@return false if the network cannot be read or an accumulator differs from its recount */
+bool bench_nnue(const std::string &path, int rounds)
+{
+    std::cout << "NNUE, " << path << '\n';
+    if (!Nnue::network.open(path))
+    {
+        std::cout << "  cannot read the network, expected " << Nnue::WEIGHT_BYTES << " bytes of weights\n\n";
+        return false;
+    }
+    select_eval_backend(EvalBackend::NNUE);
+
+    bool passed = true;
+    for (const std::string &fen : BENCH_FENS)
+    {
+        EvalBoard board(fen);
+        passed = nnue_accumulators_match(board, 3) && passed;
+    }
+    std::cout << "  incremental accumulators " << (passed ? "match their recounts" : "DIFFER from their recounts") << '\n';
+
+    std::vector<EvalBoard> boards;
+    std::vector<chess::Move> first_moves;
+    for (const chess::Board &board : two_ply_positions())
+    {
+        chess::Movelist moves;
+        chess::movegen::legalmoves(moves, board);
+        if (moves.empty())
+            continue;
+        boards.emplace_back(board);
+        first_moves.push_back(moves[0]);
+    }
+    const std::uint64_t count = static_cast<std::uint64_t>(rounds) * boards.size();
+
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const EvalBoard &board : boards)
+            checksum += board.nnue_evaluate();
+    const double eval_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (std::size_t i = 0; i < boards.size(); ++i)
+        {
+            boards[i].makeMove(first_moves[i]);
+            boards[i].unmakeMove(first_moves[i]);
+        }
+    const double update_seconds = seconds_since(start);
+
+    Nnue::Accumulator accumulator;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const EvalBoard &board : boards)
+        {
+            accumulator.refresh(board);
+            checksum += accumulator.values[0][0];
+        }
+    const double refresh_seconds = seconds_since(start);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  evaluate:          " << 1e9 * eval_seconds / count << " ns (checksum " << checksum << ")\n";
+    std::cout << "  make + unmake:     " << 1e9 * update_seconds / count << " ns\n";
+    std::cout << "  full refresh:      " << 1e9 * refresh_seconds / count << " ns\n\n";
+
+    bench_search(8);
+    select_eval_backend(EvalBackend::CLASSICAL);
+    return passed;
+}
+
+struct SmpResult
+{
+    int threads;
+    double seconds;
+    std::uint64_t nodes;
+};
+
+// Searches every bench position to a fixed depth and measures time-to-depth.
+SmpResult run_smp(int threads, int depth)
+{
+    std::uint64_t total_nodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string &fen : BENCH_FENS)
+    {
+        transposition_table.clear();
+        chess::Board board(fen);
+        std::uint64_t nodes = 0;
+        find_best_move(board, depth, board.sideToMove(), threads, &nodes);
+        total_nodes += nodes;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {threads, seconds, total_nodes};
+}
+
+// Reports time-to-depth speedup and nodes-per-second scaling for each thread count.
+void bench_smp(int depth, int max_threads)
+{
+    std::cout << "Lazy SMP benchmark, depth " << depth << ", " << BENCH_FENS.size() << " positions\n";
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "seconds" << std::setw(14) << "nodes"
+              << std::setw(14) << "nps" << std::setw(10) << "speedup" << std::setw(12) << "nps_scale" << '\n';
+
+    SmpResult base{};
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        SmpResult r = run_smp(threads, depth);
+        if (threads == 1)
+            base = r;
+        double nps = r.nodes / std::max(r.seconds, 1e-9);
+        double base_nps = base.nodes / std::max(base.seconds, 1e-9);
+        std::cout << std::setw(8) << r.threads << std::setw(12) << std::fixed << std::setprecision(3) << r.seconds
+                  << std::setw(14) << r.nodes << std::setw(14) << static_cast<std::uint64_t>(nps)
+                  << std::setw(10) << std::setprecision(2) << base.seconds / std::max(r.seconds, 1e-9)
+                  << std::setw(12) << nps / base_nps << '\n';
+    }
+}
+
+/*
+Usage:
+    bench                                       perft, eval and search with the defaults below
+    bench perft [max_depth]                     0 runs every case at its full depth
+    bench time
+    bench eval [rounds]
+    bench batch [rounds]
+    bench records [rounds]
+    bench log [rounds]
+    bench search [depth] [hash_mb]
+    bench smp [depth] [max_threads] [hash_mb]
+    bench nnue <network> [rounds]
+Any of no-nmp, no-lmr, no-rfp, no-fp and no-lazy may be added anywhere to switch off null move pruning,
+late move reductions, reverse futility or futility pruning, or lazy evaluation, to compare node counts and branching factors.
+Exits with a non-zero status if a perft count is wrong, a time manager deadline is past the clock, or batched evaluation disagrees with single evaluation,
+or a position loaded from a binary record differs from the same position set up from FEN,
+or a game logged through GameLog is missing from its file,
+or an NNUE accumulator kept through moves differs from a recount. */
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string token = argv[i];
+        if (token == "no-nmp")
+            search_options.null_move = false;
+        else if (token == "no-lmr")
+            search_options.lmr = false;
+        else if (token == "no-rfp")
+            search_options.reverse_futility = false;
+        else if (token == "no-fp")
+            search_options.futility = false;
+        else if (token == "no-lazy")
+            search_options.lazy_eval = false;
+        else
+            args.push_back(token);
+    }
+
+    const std::string mode = args.empty() ? "all" : args[0];
+    auto arg = [&](std::size_t index, long long fallback)
+    { return args.size() > index - 1 ? std::stoll(args[index - 1]) : fallback; };
+
+    bool passed = true;
+    if (mode == "perft")
+        passed = bench_perft(arg(2, 0));
+    else if (mode == "time")
+        passed = bench_time_manager();
+    else if (mode == "eval")
+        bench_eval(arg(2, 100000));
+    else if (mode == "batch")
+        passed = bench_batch_eval(arg(2, 10));
+    else if (mode == "records")
+        passed = bench_records(arg(2, 10));
+    else if (mode == "log")
+        passed = bench_game_log(arg(2, 20));
+    else if (mode == "search")
+    {
+        transposition_table.resize(arg(3, TranspositionTable::DEFAULT_SIZE_MB));
+        bench_search(arg(2, 8));
+    }
+    else if (mode == "nnue" && args.size() >= 2)
+        passed = bench_nnue(args[1], arg(3, 100));
+    else if (mode == "smp")
+    {
+        transposition_table.resize(arg(4, TranspositionTable::DEFAULT_SIZE_MB));
+        bench_smp(arg(2, 6), arg(3, 16));
+    }
+    else if (mode == "all")
+    {
+        passed = bench_perft(4);
+        passed = bench_time_manager() && passed;
+        bench_eval(100000);
+        passed = bench_batch_eval(10) && passed;
+        passed = bench_records(10) && passed;
+        passed = bench_game_log(5) && passed;
+        bench_search(8);
+    }
+    else
+    {
+        std::cerr << "Unknown bench mode " << mode << ", expected perft, time, eval, batch, records, log, search, smp or nnue <network>\n";
+        return EXIT_FAILURE;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
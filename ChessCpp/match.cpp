@@ -0,0 +1,776 @@
+#include "chess.hpp"
+#include "MovePicker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+Self-play matches between two UCI engines (POSIX only, the engines run as child processes).
+
+    match "<engine a>" "<engine b>" <openings.epd|openings.pgn> [setting=value ...]
+
+An engine is a command followed by any number of UCI options as Name=value, given as one
+argument: "./uci_old", "./uci LMR=false Hash=32". So two builds, or one build in two
+configurations, are compared the same way. Settings:
+    games=N        games to play, two per opening with colours swapped (default 200)
+    concurrency=N  games played at once (default half the cores)
+    tc=B+I         a clock of B seconds plus I seconds per move (default 10+0.1)
+    movetime=MS    a fixed time per move instead of a clock
+    nodes=N        a fixed number of nodes per move instead of a clock
+    pgn=FILE       where the games are written, each as soon as it ends (default match.pgn)
+    sprt=E0,E1     stop once a sequential probability ratio test accepts elo = E0 or
+                   elo = E1 for engine a (alpha = beta = 0.05)
+
+Openings are used in file order, wrapping around. An EPD or FEN line is a start position;
+a PGN game is its start position plus its moves. Each opening is played twice with the
+colours swapped, and the two games are scored as one pair (pentanomial statistics), which
+removes most of the noise an unbalanced opening would add.
+
+After every pair the score, Elo with its 95% interval and the LLR go to stdout. At the end
+come each engine's nodes per second, counted from the nodes of its last info line on each
+move over the time the harness measured it thinking. At equal time, a change that only
+makes the engine faster should show an NPS gain and an Elo gain together. */
+
+constexpr std::int64_t STARTUP_TIMEOUT_MS = 10000;
+constexpr std::int64_t TIME_MARGIN_MS = 100;     // Pipe and scheduling overhead allowed on top of a clock
+constexpr std::int64_t HANG_TIMEOUT_MS = 10000;   // Longest wait past the end of a fixed time move
+constexpr std::int64_t NODES_TIMEOUT_MS = 60000;  // Longest wait for a fixed node move
+
+struct MatchSettings
+{
+    int games = 200;
+    int concurrency = static_cast<int>(std::max(std::thread::hardware_concurrency() / 2, 1u));
+    std::int64_t base_ms = 10000;
+    std::int64_t increment_ms = 100;
+    std::int64_t movetime_ms = 0;
+    std::uint64_t nodes = 0;
+    std::string pgn_path = "match.pgn";
+    bool sprt = false;
+    double elo0 = 0, elo1 = 5;
+};
+
+struct EngineSpec
+{
+    std::string name;    // The argument as given, which tells two configurations of one build apart
+    std::string command; // Run through /bin/sh
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+EngineSpec parse_engine(const std::string &argument)
+{
+    EngineSpec spec{argument, "", {}};
+    std::istringstream tokens(argument);
+    std::string token;
+    while (tokens >> token)
+    {
+        const std::size_t equals = token.find('=');
+        if (!spec.command.empty() && equals != std::string::npos)
+            spec.options.emplace_back(token.substr(0, equals), token.substr(equals + 1));
+        else
+            spec.command += (spec.command.empty() ? "" : " ") + token;
+    }
+    return spec;
+}
+
+// A child process with its stdin and stdout on pipes, read line by line with a timeout.
+class EngineProcess
+{
+public:
+    explicit EngineProcess(const std::string &command)
+    {
+        int to_child[2], from_child[2];
+        if (pipe2(to_child, O_CLOEXEC) != 0)
+            return;
+        if (pipe2(from_child, O_CLOEXEC) != 0)
+        {
+            close(to_child[0]);
+            close(to_child[1]);
+            return;
+        }
+        pid = fork();
+        if (pid == 0)
+        {
+            dup2(to_child[0], STDIN_FILENO);
+            dup2(from_child[1], STDOUT_FILENO);
+            execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+            _exit(127);
+        }
+        close(to_child[0]);
+        close(from_child[1]);
+        to_engine = to_child[1];
+        from_engine = from_child[0];
+        if (pid < 0)
+            close_pipes();
+    }
+
+    ~EngineProcess()
+    {
+        if (pid <= 0)
+            return;
+        send("quit");
+        close_pipes();
+        // Give it a moment to exit on its own, then kill it.
+        for (int waited = 0; waited < 100; ++waited)
+        {
+            if (waitpid(pid, nullptr, WNOHANG) == pid)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    EngineProcess(const EngineProcess &) = delete;
+    EngineProcess &operator=(const EngineProcess &) = delete;
+
+    bool send(const std::string &line)
+    {
+        if (to_engine < 0)
+            return false;
+        const std::string text = line + '\n';
+        std::size_t written = 0;
+        while (written < text.size())
+        {
+            const ssize_t result = write(to_engine, text.data() + written, text.size() - written);
+            if (result <= 0)
+                return false;
+            written += static_cast<std::size_t>(result);
+        }
+        return true;
+    }
+
+    /// @brief Reads the next line, waiting at most timeout_ms for it.
+    /// @return false on timeout or once the engine has closed its output
+    bool read_line(std::string &line, std::int64_t timeout_ms)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true)
+        {
+            const std::size_t end = buffer.find('\n');
+            if (end != std::string::npos)
+            {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                return true;
+            }
+            if (from_engine < 0)
+                return false;
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            pollfd ready{from_engine, POLLIN, 0};
+            if (remaining <= 0 || poll(&ready, 1, static_cast<int>(remaining)) <= 0)
+                return false;
+            char chunk[4096];
+            const ssize_t count = read(from_engine, chunk, sizeof(chunk));
+            if (count <= 0)
+                return false;
+            buffer.append(chunk, static_cast<std::size_t>(count));
+        }
+    }
+
+private:
+    pid_t pid = -1;
+    int to_engine = -1;
+    int from_engine = -1;
+    std::string buffer; // Read but not yet returned
+
+    void close_pipes()
+    {
+        if (to_engine >= 0)
+            close(to_engine);
+        if (from_engine >= 0)
+            close(from_engine);
+        to_engine = from_engine = -1;
+    }
+};
+
+// What one engine answered to one go.
+struct EngineMove
+{
+    std::string move;        // UCI text of the bestmove, empty if none came
+    std::uint64_t nodes = 0; // From the last info line that had them
+    std::int64_t elapsed_ms = 0;
+};
+
+// A UCI session. After a timeout or a crash it is in an unknown state and is restarted before its next game.
+class Engine
+{
+public:
+    explicit Engine(const EngineSpec &spec) : spec(spec) {}
+
+    const std::string &name() const { return spec.name; }
+
+    /// @brief Starts the engine if it is not running, then tells it a new game begins.
+    /// @return false if it does not answer the handshake
+    bool new_game()
+    {
+        if (!process)
+        {
+            process = std::make_unique<EngineProcess>(spec.command);
+            if (!process->send("uci") || !wait_for("uciok", STARTUP_TIMEOUT_MS))
+                return reset();
+            for (const auto &[option, value] : spec.options)
+                process->send("setoption name " + option + " value " + value);
+        }
+        if (!process->send("ucinewgame") || !process->send("isready") || !wait_for("readyok", STARTUP_TIMEOUT_MS))
+            return reset();
+        return true;
+    }
+
+    /// @brief Sends the position and go, and waits up to timeout_ms for the bestmove.
+    EngineMove think(const std::string &position, const std::string &go, std::int64_t timeout_ms)
+    {
+        EngineMove answer;
+        const auto start = std::chrono::steady_clock::now();
+        if (!process || !process->send(position) || !process->send(go))
+        {
+            reset();
+            return answer;
+        }
+        std::string line;
+        while (process->read_line(line, timeout_ms - elapsed_since(start)))
+        {
+            std::istringstream fields(line);
+            std::string token;
+            fields >> token;
+            if (token == "bestmove")
+            {
+                fields >> answer.move;
+                answer.elapsed_ms = elapsed_since(start);
+                return answer;
+            }
+            if (token == "info")
+                while (fields >> token)
+                    if (token == "nodes")
+                        fields >> answer.nodes;
+        }
+        answer.elapsed_ms = elapsed_since(start);
+        reset();
+        return answer;
+    }
+
+private:
+    EngineSpec spec;
+    std::unique_ptr<EngineProcess> process;
+
+    static std::int64_t elapsed_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool wait_for(const std::string &reply, std::int64_t timeout_ms)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::string line;
+        while (process->read_line(line, timeout_ms - elapsed_since(start)))
+            if (line == reply)
+                return true;
+        return false;
+    }
+
+    bool reset()
+    {
+        process.reset();
+        return false;
+    }
+};
+
+// A start position and the moves played from it before the engines take over.
+struct Opening
+{
+    std::string fen;
+    std::vector<chess::Move> moves;
+};
+
+class OpeningVisitor : public chess::pgn::Visitor
+{
+public:
+    explicit OpeningVisitor(std::vector<Opening> &openings) : openings(openings) {}
+
+    void startPgn() override
+    {
+        board.setFen(chess::constants::STARTPOS);
+        openings.push_back({board.getFen(), {}});
+        broken = false;
+    }
+
+    void header(std::string_view key, std::string_view value) override
+    {
+        if (key == "FEN")
+        {
+            board.setFen(value);
+            openings.back().fen = board.getFen();
+        }
+    }
+
+    void startMoves() override {}
+
+    void move(std::string_view san, std::string_view) override
+    {
+        if (broken)
+            return;
+        chess::Move move = chess::Move::NO_MOVE;
+        try
+        {
+            move = chess::uci::parseSan(board, san);
+        }
+        catch (const std::exception &)
+        {
+        }
+        if (!is_legal(board, move))
+        {
+            broken = true; // The opening ends before the bad move
+            return;
+        }
+        board.makeMove(move);
+        openings.back().moves.push_back(move);
+    }
+
+    void endPgn() override {}
+
+private:
+    std::vector<Opening> &openings;
+    chess::Board board;
+    bool broken = false;
+};
+
+std::vector<Opening> read_openings(const std::string &path)
+{
+    std::vector<Opening> openings;
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+        return openings;
+    if (path.ends_with(".pgn"))
+    {
+        OpeningVisitor visitor(openings);
+        chess::pgn::StreamParser parser(input);
+        parser.readGames(visitor);
+        return openings;
+    }
+
+    // EPD or FEN, one position per line. The move counters are taken when the line has them.
+    std::string line;
+    chess::Board board;
+    while (std::getline(input, line))
+    {
+        std::istringstream fields(line);
+        std::vector<std::string> parts;
+        std::string field;
+        while (parts.size() < 6 && fields >> field)
+            parts.push_back(field);
+        if (parts.size() < 4 || parts[0][0] == '#')
+            continue;
+        std::string fen = parts[0] + ' ' + parts[1] + ' ' + parts[2] + ' ' + parts[3];
+        const bool counters = parts.size() == 6 && std::all_of(parts[4].begin(), parts[4].end(), ::isdigit) &&
+                              std::all_of(parts[5].begin(), parts[5].end(), ::isdigit);
+        fen += counters ? ' ' + parts[4] + ' ' + parts[5] : " 0 1";
+        board.setFen(fen);
+        openings.push_back({board.getFen(), {}});
+    }
+    return openings;
+}
+
+// Writes every game as it ends, so an interrupted match keeps the games already played.
+class PgnWriter
+{
+public:
+    explicit PgnWriter(const std::string &path) : output(path) {}
+
+    bool is_open() const { return output.is_open(); }
+
+    void write(const std::string &game)
+    {
+        std::lock_guard lock(mutex);
+        output << game << std::flush;
+    }
+
+private:
+    std::mutex mutex;
+    std::ofstream output;
+};
+
+struct GameScore
+{
+    double white_score = 0.5;
+    std::string result = "1/2-1/2";
+    std::string reason;
+};
+
+// Totals of one engine over the match.
+struct EngineTotals
+{
+    std::uint64_t nodes = 0;
+    std::int64_t think_ms = 0;
+};
+
+/*
+Plays one game from an opening. The opening moves are sent to the engines as part of the
+position, so they know the game's history, and are written to the PGN like any other move.
+@param totals Nodes and thinking time of white and black, added to */
+GameScore play_game(Engine &white, Engine &black, const Opening &opening, const MatchSettings &settings, int round, PgnWriter &pgn,
+                     std::array<EngineTotals, 2> &totals)
+{
+    chess::Board board(opening.fen);
+    std::vector<std::string> san;
+    std::string position = "position fen " + opening.fen;
+    auto play = [&](chess::Move move)
+    {
+        san.push_back(chess::uci::moveToSan(board, move));
+        position += (san.size() == 1 ? " moves " : " ") + chess::uci::moveToUci(move);
+        board.makeMove(move);
+    };
+    for (chess::Move move : opening.moves)
+        play(move);
+
+    Engine *engines[2] = {&white, &black};
+    std::int64_t clock[2] = {settings.base_ms, settings.base_ms};
+    GameScore game;
+    auto lose = [&](chess::Color side, const std::string &reason)
+    {
+        game.white_score = side == chess::Color::WHITE ? 0 : 1;
+        game.result = side == chess::Color::WHITE ? "0-1" : "1-0";
+        game.reason = reason;
+    };
+
+    if (!white.new_game())
+        lose(chess::Color::WHITE, "White does not start");
+    else if (!black.new_game())
+        lose(chess::Color::BLACK, "Black does not start");
+
+    while (game.reason.empty())
+    {
+        const auto [reason, outcome] = board.isGameOver();
+        if (reason != chess::GameResultReason::NONE)
+        {
+            if (outcome == chess::GameResult::LOSE)
+                lose(board.sideToMove(), board.sideToMove() == chess::Color::WHITE ? "Black mates" : "White mates");
+            else
+                game.reason = reason == chess::GameResultReason::STALEMATE               ? "Stalemate"
+                              : reason == chess::GameResultReason::INSUFFICIENT_MATERIAL ? "Insufficient material"
+                              : reason == chess::GameResultReason::FIFTY_MOVE_RULE       ? "Fifty move rule"
+                                                                                         : "Threefold repetition";
+            break;
+        }
+
+        const chess::Color side = board.sideToMove();
+        const std::string mover = side == chess::Color::WHITE ? "White" : "Black";
+        std::string go;
+        std::int64_t timeout_ms;
+        if (settings.nodes)
+        {
+            go = "go nodes " + std::to_string(settings.nodes);
+            timeout_ms = NODES_TIMEOUT_MS;
+        }
+        else if (settings.movetime_ms)
+        {
+            go = "go movetime " + std::to_string(settings.movetime_ms);
+            timeout_ms = settings.movetime_ms + HANG_TIMEOUT_MS;
+        }
+        else
+        {
+            go = "go wtime " + std::to_string(clock[0]) + " btime " + std::to_string(clock[1]) + " winc " + std::to_string(settings.increment_ms) +
+                 " binc " + std::to_string(settings.increment_ms);
+            timeout_ms = clock[side] + TIME_MARGIN_MS;
+        }
+
+        const EngineMove answer = engines[side]->think(position, go, timeout_ms);
+        totals[side].nodes += answer.nodes;
+        totals[side].think_ms += answer.elapsed_ms;
+        if (answer.move.empty())
+        {
+            lose(side, answer.elapsed_ms >= timeout_ms ? mover + " loses on time" : mover + " disconnects");
+            break;
+        }
+        if (!settings.nodes && !settings.movetime_ms)
+        {
+            if (answer.elapsed_ms > clock[side] + TIME_MARGIN_MS)
+            {
+                lose(side, mover + " loses on time");
+                break;
+            }
+            clock[side] = std::max<std::int64_t>(clock[side] - answer.elapsed_ms, 0) + settings.increment_ms;
+        }
+
+        const chess::Move move = chess::uci::uciToMove(board, answer.move);
+        if (!is_legal(board, move))
+        {
+            lose(side, mover + " plays the illegal move " + answer.move);
+            break;
+        }
+        play(move);
+    }
+
+    // The game in PGN, movetext wrapped at 80 columns.
+    std::ostringstream out;
+    out << "[Event \"Self-play match\"]\n[Round \"" << round << "\"]\n[White \"" << white.name() << "\"]\n[Black \"" << black.name()
+        << "\"]\n[Result \"" << game.result << "\"]\n";
+    if (opening.fen != chess::constants::STARTPOS)
+        out << "[SetUp \"1\"]\n[FEN \"" << opening.fen << "\"]\n";
+    out << "[PlyCount \"" << san.size() << "\"]\n\n";
+
+    chess::Board numbering(opening.fen);
+    int move_number = numbering.fullMoveNumber();
+    bool white_to_move = numbering.sideToMove() == chess::Color::WHITE;
+    std::string text, line;
+    auto add = [&](const std::string &word)
+    {
+        if (!line.empty() && line.size() + 1 + word.size() > 80)
+        {
+            text += line + '\n';
+            line.clear();
+        }
+        line += (line.empty() ? "" : " ") + word;
+    };
+    for (std::size_t ply = 0; ply < san.size(); ++ply)
+    {
+        if (white_to_move)
+            add(std::to_string(move_number) + ". " + san[ply]);
+        else if (ply == 0)
+            add(std::to_string(move_number) + "... " + san[ply]);
+        else
+            add(san[ply]);
+        if (!white_to_move)
+            ++move_number;
+        white_to_move = !white_to_move;
+    }
+    add("{" + game.reason + "}");
+    add(game.result);
+    out << text << line << "\n\n";
+    pgn.write(out.str());
+    return game;
+}
+
+double elo_to_score(double elo)
+{
+    return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+double score_to_elo(double score)
+{
+    score = std::clamp(score, 1e-6, 1 - 1e-6);
+    return -400 * std::log10(1 / score - 1);
+}
+
+/*
+Results from engine a's side. A pair of games from one opening scores 0, 0.5, 1, 1.5 or 2
+points, and the statistics are over those pair scores: the two games of a pair are not
+independent (the same opening favours one side in both), and counting them as one sample
+gives an honest, usually smaller, variance. */
+struct MatchStats
+{
+    std::array<std::uint64_t, 5> pairs = {}; // By a's points in the pair, in half points
+    std::uint64_t wins = 0, draws = 0, losses = 0;
+    std::array<EngineTotals, 2> engines = {};
+
+    std::uint64_t pair_count() const
+    {
+        std::uint64_t count = 0;
+        for (std::uint64_t n : pairs)
+            count += n;
+        return count;
+    }
+
+    double mean() const
+    {
+        double points = 0;
+        for (int k = 0; k < 5; ++k)
+            points += pairs[k] * k / 4.0;
+        return points / std::max<std::uint64_t>(pair_count(), 1);
+    }
+
+    // Variance of one pair's score, as a fraction of its two points.
+    double variance() const
+    {
+        const double average = mean();
+        double sum = 0;
+        for (int k = 0; k < 5; ++k)
+            sum += pairs[k] * (k / 4.0 - average) * (k / 4.0 - average);
+        return sum / std::max<std::uint64_t>(pair_count(), 1);
+    }
+
+    // Elo difference and the half width of its 95% interval.
+    std::pair<double, double> elo() const
+    {
+        const double average = mean();
+        const double error = 1.96 * std::sqrt(variance() / std::max<std::uint64_t>(pair_count(), 1));
+        return {score_to_elo(average), (score_to_elo(average + error) - score_to_elo(average - error)) / 2};
+    }
+
+    /// @brief Log-likelihood ratio of elo1 against elo0, with the normal approximation to the pair scores.
+    double llr(double elo0, double elo1) const
+    {
+        const double var = variance();
+        if (var <= 0)
+            return 0;
+        const double s0 = elo_to_score(elo0), s1 = elo_to_score(elo1);
+        return pair_count() * (s1 - s0) * (2 * mean() - s0 - s1) / (2 * var);
+    }
+};
+
+double nodes_per_second(const EngineTotals &totals)
+{
+    return totals.nodes * 1000.0 / std::max<std::int64_t>(totals.think_ms, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: match \"<engine a> [Option=value ...]\" \"<engine b> [Option=value ...]\" <openings.epd|openings.pgn>\n"
+                     "             [games=N] [concurrency=N] [tc=B+I | movetime=MS | nodes=N] [pgn=FILE] [sprt=E0,E1]\n";
+        return EXIT_FAILURE;
+    }
+    std::signal(SIGPIPE, SIG_IGN); // A dead engine shows up as a failed write, not a dead harness
+
+    const std::array<EngineSpec, 2> specs = {parse_engine(argv[1]), parse_engine(argv[2])};
+    MatchSettings settings;
+    try
+    {
+        for (int i = 4; i < argc; ++i)
+        {
+            const std::string setting = argv[i];
+            const std::size_t equals = setting.find('=');
+            const std::string key = setting.substr(0, equals), value = equals == std::string::npos ? "" : setting.substr(equals + 1);
+            if (key == "games")
+                settings.games = std::max(std::stoi(value), 1);
+            else if (key == "concurrency")
+                settings.concurrency = std::max(std::stoi(value), 1);
+            else if (key == "tc")
+            {
+                const std::size_t plus = value.find('+');
+                settings.base_ms = static_cast<std::int64_t>(std::stod(value.substr(0, plus)) * 1000);
+                settings.increment_ms = plus == std::string::npos ? 0 : static_cast<std::int64_t>(std::stod(value.substr(plus + 1)) * 1000);
+            }
+            else if (key == "movetime")
+                settings.movetime_ms = std::max<std::int64_t>(std::stoll(value), 1);
+            else if (key == "nodes")
+                settings.nodes = std::max<std::uint64_t>(std::stoull(value), 1);
+            else if (key == "pgn")
+                settings.pgn_path = value;
+            else if (key == "sprt")
+            {
+                const std::size_t comma = value.find(',');
+                settings.elo0 = std::stod(value.substr(0, comma));
+                settings.elo1 = std::stod(value.substr(comma + 1));
+                settings.sprt = comma != std::string::npos && settings.elo1 > settings.elo0;
+                if (!settings.sprt)
+                    throw std::invalid_argument(value);
+            }
+            else
+                throw std::invalid_argument(setting);
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid setting, expected games=N, concurrency=N, tc=B+I, movetime=MS, nodes=N, pgn=FILE or sprt=E0,E1 with E1 > E0\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<Opening> openings = read_openings(argv[3]);
+    if (openings.empty())
+    {
+        std::cerr << "No openings in " << argv[3] << '\n';
+        return EXIT_FAILURE;
+    }
+    PgnWriter pgn(settings.pgn_path);
+    if (!pgn.is_open())
+    {
+        std::cerr << "Cannot write " << settings.pgn_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    const double lower = std::log(0.05 / 0.95), upper = std::log(0.95 / 0.05);
+    const int pair_total = (settings.games + 1) / 2;
+    std::cout << specs[0].name << " vs " << specs[1].name << ": " << pair_total * 2 << " games from " << openings.size() << " openings, "
+              << settings.concurrency << " at a time, "
+              << (settings.nodes      ? std::to_string(settings.nodes) + " nodes per move"
+                  : settings.movetime_ms ? std::to_string(settings.movetime_ms) + " ms per move"
+                                         : std::to_string(settings.base_ms) + "+" + std::to_string(settings.increment_ms) + " ms")
+              << '\n';
+
+    MatchStats stats;
+    std::mutex stats_mutex;
+    std::atomic<int> next_pair{0};
+    std::atomic<bool> finished{false}; // Set once the SPRT has decided
+
+    // Each worker runs its own pair of engine processes and plays whole pairs of games.
+    auto worker = [&]
+    {
+        Engine a(specs[0]), b(specs[1]);
+        int pair;
+        while (!finished.load() && (pair = next_pair.fetch_add(1)) < pair_total)
+        {
+            const Opening &opening = openings[pair % openings.size()];
+            std::array<EngineTotals, 2> first = {}, second = {};
+            const GameScore a_white = play_game(a, b, opening, settings, 2 * pair + 1, pgn, first);
+            const GameScore b_white = play_game(b, a, opening, settings, 2 * pair + 2, pgn, second);
+            const double a_points = a_white.white_score + (1 - b_white.white_score);
+
+            std::lock_guard lock(stats_mutex);
+            ++stats.pairs[static_cast<int>(a_points * 2 + 0.5)];
+            for (double score : {a_white.white_score, 1 - b_white.white_score})
+                ++(score == 1 ? stats.wins : score == 0 ? stats.losses : stats.draws);
+            stats.engines[0].nodes += first[0].nodes + second[1].nodes;
+            stats.engines[0].think_ms += first[0].think_ms + second[1].think_ms;
+            stats.engines[1].nodes += first[1].nodes + second[0].nodes;
+            stats.engines[1].think_ms += first[1].think_ms + second[0].think_ms;
+
+            const auto [elo, error] = stats.elo();
+            std::cout << "Games " << stats.wins + stats.draws + stats.losses << ": +" << stats.wins << " =" << stats.draws << " -" << stats.losses
+                      << std::fixed << std::setprecision(1) << "  Elo " << elo << " +/- " << error;
+            if (settings.sprt)
+            {
+                const double llr = stats.llr(settings.elo0, settings.elo1);
+                std::cout << std::setprecision(2) << "  LLR " << llr << " (" << lower << ", " << upper << ")";
+                if (llr <= lower || llr >= upper)
+                    finished.store(true);
+            }
+            std::cout << std::defaultfloat << std::endl;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < settings.concurrency; ++i)
+        workers.emplace_back(worker);
+    for (std::thread &thread : workers)
+        thread.join();
+
+    const auto [elo, error] = stats.elo();
+    const double nps_a = nodes_per_second(stats.engines[0]), nps_b = nodes_per_second(stats.engines[1]);
+    std::cout << std::fixed << std::setprecision(1) << "\nScore of " << specs[0].name << " vs " << specs[1].name << ": +" << stats.wins << " ="
+              << stats.draws << " -" << stats.losses << "\nPairs (0, 0.5, 1, 1.5, 2 points): " << stats.pairs[0] << ", " << stats.pairs[1]
+              << ", " << stats.pairs[2] << ", " << stats.pairs[3] << ", " << stats.pairs[4] << "\nElo: " << elo << " +/- " << error << '\n';
+    if (settings.sprt)
+    {
+        const double llr = stats.llr(settings.elo0, settings.elo1);
+        std::cout << std::setprecision(2) << "SPRT elo0 " << settings.elo0 << " elo1 " << settings.elo1 << ": LLR " << llr << " ("
+                  << lower << ", " << upper << "), "
+                  << (llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "inconclusive") << '\n';
+    }
+    std::cout << std::setprecision(0) << "NPS: " << nps_a << " vs " << nps_b;
+    if (nps_b > 0)
+        std::cout << std::setprecision(1) << " (" << std::showpos << (nps_a / nps_b - 1) * 100 << std::noshowpos << "%)";
+    std::cout << '\n';
+    return EXIT_SUCCESS;
+}
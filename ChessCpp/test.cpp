@@ -1,12 +1,14 @@
 #include "chess.hpp"
 #include "Eval.hpp"
+#include "GameLog.hpp"
+#include "OpeningBook.hpp"
+#include "Search.hpp"
 
 #include <queue>
 #include <chrono>
 #include <ctime>
 #include <fstream>
 #include <limits>
-#include <unordered_map>
 
 void tokenize(const std::string move, std::string &from_square, std::string &to_square, chess::PieceType &promotion_piece, int &is_castling)
 {
@@ -60,176 +62,22 @@ void tokenize(const std::string move, std::string &from_square, std::string &to_
     }
 }
 
-struct MoveEval
-{
-    chess::Move move;
-    int eval;
-};
-
-bool compareMoves(const MoveEval &a, const MoveEval &b)
-{
-    return a.eval > b.eval;
-}
-
-struct TranspositionEntry
-{
-    int value;
-    int depth;
-    bool is_exact;
-};
-
-std::unordered_map<std::size_t, TranspositionEntry> transposition_table;
-
-int Minimax(chess::Board &data, int depth, int alpha, int beta, bool maximizing_player)
-{
-    if (depth == 0 || data.isGameOver().first != chess::GameResultReason::NONE)
-    {
-        Evaluation e(data, chess::Color::WHITE);
-        return e.static_eval();
-    }
-
-    std::size_t hash = data.hash();
-    if (transposition_table.find(hash) != transposition_table.end())
-    {
-        const TranspositionEntry &entry = transposition_table[hash];
-        if (entry.depth >= depth)
-        {
-            if (entry.is_exact)
-                return entry.value;
-            if (maximizing_player && entry.value <= alpha)
-                return entry.value;
-            if (!maximizing_player && entry.value >= beta)
-                return entry.value;
-        }
-    }
-
-    chess::Movelist moves;
-    chess::movegen::legalmoves(moves, data);
-
-    if (moves.empty())
-    {
-        return maximizing_player ? -std::numeric_limits<int>::infinity() : std::numeric_limits<int>::infinity();
-    }
-
-    std::vector<MoveEval> move_evals;
-    for (const auto &move : moves)
-    {
-        data.makeMove(move);
-        int eval = Evaluation(data, data.sideToMove()).static_eval();
-        move_evals.push_back({move, eval});
-        data.unmakeMove(move);
-    }
-
-    std::sort(move_evals.begin(), move_evals.end(), compareMoves);
-
-    int eval;
-    if (maximizing_player)
-    {
-        int max_eval = -std::numeric_limits<int>::infinity();
-        for (auto &move_eval : move_evals)
-        {
-            data.makeMove(move_eval.move);
-            eval = Minimax(data, depth - 1, alpha, beta, false);
-            data.unmakeMove(move_eval.move);
-            move_eval.move.setScore(eval);
-            max_eval = std::max(max_eval, eval);
-            alpha = std::max(alpha, eval);
-            if (beta <= alpha)
-                break; // Beta cut-off
-        }
-        transposition_table[hash] = {max_eval, depth, true};
-        return max_eval;
-    }
-    else
-    {
-        int min_eval = std::numeric_limits<int>::infinity();
-        for (auto &move_eval : move_evals)
-        {
-            data.makeMove(move_eval.move);
-            eval = Minimax(data, depth - 1, alpha, beta, true);
-            data.unmakeMove(move_eval.move);
-            move_eval.move.setScore(eval);
-            min_eval = std::min(min_eval, eval);
-            beta = std::min(beta, min_eval);
-            if (beta <= alpha)
-                break; // Alpha cut-off
-        }
-        transposition_table[hash] = {min_eval, depth, true};
-        return min_eval;
-    }
-}
-
-chess::Move find_best_move(chess::Board &data, int max_depth, chess::Color color)
-{
-    chess::Move best_move;
-    int best_eval = (color == chess::Color::WHITE) ? -std::numeric_limits<int>::infinity() : std::numeric_limits<int>::infinity();
-
-    for (int depth = 1; depth <= max_depth; ++depth)
-    {
-        int alpha = -std::numeric_limits<int>::infinity();
-        int beta = std::numeric_limits<int>::infinity();
-        chess::Movelist moves;
-        chess::movegen::legalmoves(moves, data);
-
-        if (moves.size() == 1)
-            return moves[0];
-
-        chess::Move best_move_for_depth = moves[0];
-        int best_eval_for_depth = (color == chess::Color::WHITE) ? -std::numeric_limits<int>::infinity() : std::numeric_limits<int>::infinity();
-
-        for (const auto &move : moves)
-        {
-            data.makeMove(move);
-            int eval;
-            if (color == chess::Color::WHITE)
-            {
-                eval = Minimax(data, depth - 1, alpha, beta, false);
-            }
-            else
-            {
-                eval = Minimax(data, depth - 1, alpha, beta, true);
-            }
-            data.unmakeMove(move);
-
-            if ((color == chess::Color::WHITE && eval > best_eval_for_depth) || (color == chess::Color::BLACK && eval < best_eval_for_depth))
-            {
-                best_eval_for_depth = eval;
-                best_move_for_depth = move;
-            }
-
-            if (color == chess::Color::WHITE)
-            {
-                alpha = std::max(alpha, best_eval_for_depth);
-            }
-            else
-            {
-                beta = std::min(beta, best_eval_for_depth);
-            }
-        }
-
-        // Update global best move
-        if ((color == chess::Color::WHITE && best_eval_for_depth > best_eval) || (color == chess::Color::BLACK && best_eval_for_depth < best_eval))
-        {
-            best_eval = best_eval_for_depth;
-            best_move = best_move_for_depth;
-        }
-
-        // Update transposition table
-        std::size_t hash = data.hash();
-        transposition_table[hash] = {best_eval, depth, true};
-    }
-
-    return best_move;
-}
-
 // Currently just lets you play againist the engine in board.txt.
-void run_engine(int depth = 30, std::string outfile = "board.txt")
+// The engine spends movetime_ms milliseconds on each of its moves, except book moves, which it plays at once.
+// Without a Polyglot book at book_file it searches every move.
+// The game is logged to outfile by a GameLog, in the format its extension asks for (.jsonl, .pgn, or the board diagram).
+// LogLevel::EVAL adds the static evaluation after every move; the default logs no evaluation.
+void run_engine(std::int64_t movetime_ms = 5000, std::string outfile = "board.txt", std::size_t hash_mb = TranspositionTable::DEFAULT_SIZE_MB, int threads = 1,
+                std::string book_file = "book.bin", LogLevel log_level = LogLevel::MOVES)
 {
     // Engine configuration variables.
     constexpr char STARTFEN[57] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     int number = 0; // used for determining number of moves made
-    std::ofstream outputFile(outfile);
+    GameLog log(outfile, log_level, GameLog::format_for(outfile));
     chess::Board board(STARTFEN);
+    transposition_table.resize(hash_mb);
+    opening_book.open(book_file);
+    const SearchLimits limits = SearchLimits::fixed_time(movetime_ms);
 
     // Side selection variables
     std::string side_choice;
@@ -257,16 +105,21 @@ void run_engine(int depth = 30, std::string outfile = "board.txt")
         player_color = chess::Color::BLACK;
     }
 
-    if (outputFile.is_open())
+    if (log.is_open() || log_level == LogLevel::OFF)
     {
-        outputFile << board << '\n';
-        outputFile << "Move evaluation: " << std::to_string(Evaluation(board, board.sideToMove()).static_eval()) << '\n';
+        const std::uint32_t game = log.start_game(board);
         while (board.isGameOver().first == chess::GameResultReason::NONE && number <= 1000)
         {
             if (board.sideToMove() != player_color)
             {
-                std::cout << "Transposition table size: " << transposition_table.size() << "\n";
-                chess::Move move = find_best_move(board, depth, player_color);
+                chess::Move move = opening_book.probe(board);
+                if (move == chess::Move::NO_MOVE)
+                {
+                    std::cout << "Transposition table hashfull: " << transposition_table.hashfull() << " / 1000\n";
+                    move = find_best_move(board, limits, threads);
+                }
+                else
+                    std::cout << "Book move\n";
 
                 // Check that what the computer played is legal. This should never happen, but this is extra assurance.
                 chess::Movelist legal_moves;
@@ -284,14 +137,12 @@ void run_engine(int depth = 30, std::string outfile = "board.txt")
                 if (!is_legal) // Something went really wrong, and we need to reset the state
                 { 
                     transposition_table.clear();
-                    chess::Move move = find_best_move(board, depth, opposite_color);
+                    move = find_best_move(board, limits, threads);
                 }
 
-                outputFile << board.sideToMove() << "'s move: " << move << '\n';
+                log.log_move(game, board, move);
                 std::cout << board.sideToMove() << "'s Move: " << move << " (Move number: " << number << ")\n";
                 board.makeMove(move);
-                outputFile << "Board fen: " << board.getFen() << '\n';
-                outputFile << "Board after move:\n" << board << '\n';
                 number++;
             }
             else
@@ -358,12 +209,8 @@ void run_engine(int depth = 30, std::string outfile = "board.txt")
 
                 if (is_legal)
                 {
+                    log.log_move(game, board, player_move);
                     board.makeMove(player_move);
-                    outputFile << "Your move: " << player_move << '\n';
-                    outputFile << "Board fen: " << board.getFen() << '\n';
-                    outputFile << "Board after move:\n"
-                               << board << '\n';
-                    outputFile << "Move evaluation: " << std::to_string(Evaluation(board, board.sideToMove()).static_eval()) << '\n';
                     std::cout << "Your Move: " << player_move << " (Move number: " << number << ")\n"
                               << std::endl;
                 }
@@ -375,6 +222,7 @@ void run_engine(int depth = 30, std::string outfile = "board.txt")
             }
         }
 
+        log.end_game(game, board);
         auto game_result = board.isGameOver();
         if (game_result.first == chess::GameResultReason::STALEMATE ||
             game_result.first == chess::GameResultReason::INSUFFICIENT_MATERIAL ||
@@ -400,11 +248,10 @@ void run_engine(int depth = 30, std::string outfile = "board.txt")
     {
         std::cerr << "Error: Unable to open output file\n";
     }
-    outputFile.close();
 }
 
 int main()
 {
-    // args: int max_depth, std::string outputfile
+    // args: std::int64_t movetime_ms, std::string outputfile, std::size_t hash_mb, int threads, std::string book_file, LogLevel log_level
     run_engine();
 }
\ No newline at end of file
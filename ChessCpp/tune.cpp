@@ -0,0 +1,532 @@
+#define EVAL_TRACE
+#include "chess.hpp"
+#include "Eval.hpp"
+#include "EvalWeights.hpp"
+#include "MappedFile.hpp"
+#include "MovePicker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Texel tuning of the weights in EvalWeights.hpp (POSIX only, the feature file is memory mapped).
+
+    tune pack <games.pgn|positions.epd> <positions.pos>
+    tune extract <games.pgn|positions.epd|positions.pos> <features.bin>
+    tune run <features.bin> <EvalWeights.hpp> [epochs] [threads]
+
+pack stores the positions of a game or EPD file in the binary position format, so later
+extracts skip the parsing. extract evaluates every usable position once, with EVAL_TRACE on, and stores how often each
+weight was applied plus the part of the score no weight touches. The evaluation is linear in
+the weights, so run can then recompute it for any weights from those few numbers alone,
+without parsing or evaluating again. run fits the sigmoid scale K to the starting weights,
+then minimises the mean squared error between sigmoid(eval) and the game results by full
+batch gradient descent (Adam), split over threads, and writes the tuned weights as a header. */
+
+struct TunableWeight
+{
+    const char *name;
+    Score initial;
+};
+
+// Indexed by EvalTerm.
+constexpr std::array<TunableWeight, EVAL_TERM_COUNT> TUNABLE_WEIGHTS = {{
+    {"doubled_pawn_penalty", EvalWeights::doubled_pawn_penalty},
+    {"isolated_pawn_penalty", EvalWeights::isolated_pawn_penalty},
+    {"passed_pawn_bonus", EvalWeights::passed_pawn_bonus},
+    {"pawn_center_control", EvalWeights::pawn_center_control},
+    {"valuable_pawn_captures_bonus", EvalWeights::valuable_pawn_captures_bonus},
+    {"backwards_pawn_penalty", EvalWeights::backwards_pawn_penalty},
+    {"pawn_chain_bonus", EvalWeights::pawn_chain_bonus},
+    {"bishop_mobility_bonus", EvalWeights::bishop_mobility_bonus},
+    {"bishop_center_bonus", EvalWeights::bishop_center_bonus},
+    {"rook_open_file_bonus", EvalWeights::rook_open_file_bonus},
+    {"stacked_rooks_bonus", EvalWeights::stacked_rooks_bonus},
+    {"rook_mobility_bonus", EvalWeights::rook_mobility_bonus},
+    {"knight_mobility_bonus", EvalWeights::knight_mobility_bonus},
+    {"king_restriction_bonus", EvalWeights::king_restriction_bonus},
+    {"checks_constant", EvalWeights::checks_constant},
+    {"queen_check_bonus", EvalWeights::queen_check_bonus},
+    {"king_double_attack_penalty", EvalWeights::king_double_attack_penalty},
+}};
+
+// One position of the feature file.
+struct TuningRecord
+{
+    std::int16_t fixed_mg = 0; // Score apart from the tuned weights
+    std::int16_t fixed_eg = 0;
+    std::uint8_t phase = 0;    // Clamped to Evaluation::MAX_PHASE
+    std::uint8_t result = 0;   // White's result: 0 loss, 1 draw, 2 win
+    std::array<std::int8_t, EVAL_TERM_COUNT> coefficients = {};
+};
+
+struct FeatureFileHeader
+{
+    char magic[4] = {'T', 'X', 'L', '1'};
+    std::uint32_t term_count = EVAL_TERM_COUNT;
+    std::uint64_t record_count = 0;
+};
+
+// Skip the opening, which mostly comes from books and says little about the evaluation.
+constexpr int SKIP_PLIES = 8;
+
+/*
+Turns a position into a record. Returns false for positions that do not suit tuning a
+static evaluation: in check, a capture or promotion available that wins material, or a
+term too large for the record's fields. */
+bool make_record(const chess::Board &board, std::uint8_t result, TuningRecord &record)
+{
+    if (board.inCheck())
+        return false;
+
+    chess::Movelist captures;
+    chess::movegen::legalmoves<chess::movegen::MoveGenType::CAPTURE>(captures, board);
+    if (captures.empty())
+    {
+        chess::Movelist moves;
+        chess::movegen::legalmoves(moves, board);
+        if (moves.empty())
+            return false; // Stalemate
+    }
+    for (const chess::Move &move : captures)
+        if (see(board, move) > 0)
+            return false;
+
+    eval_trace = EvalTrace{};
+    Evaluation evaluation(board, chess::Color::WHITE);
+    const Bitboard white_pawns = board.pieces(PieceType::PAWN, chess::Color::WHITE);
+    const Bitboard black_pawns = board.pieces(PieceType::PAWN, chess::Color::BLACK);
+    // Bypass the pawn hash, a hit would not trace the pawn structure terms.
+    evaluation.evaluate_with_pawn_structure(Evaluation::pawn_structure_score(white_pawns, black_pawns));
+
+    // The fixed part is summed per half in full ints: in a packed Score a half past 16 bits would wrap unseen.
+    int fixed_mg = mg_value(eval_trace.total), fixed_eg = eg_value(eval_trace.total);
+    for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+    {
+        const int coefficient = eval_trace.coefficients[term];
+        if (coefficient < -127 || coefficient > 127)
+            return false;
+        record.coefficients[term] = static_cast<std::int8_t>(coefficient);
+        fixed_mg -= coefficient * mg_value(TUNABLE_WEIGHTS[term].initial);
+        fixed_eg -= coefficient * eg_value(TUNABLE_WEIGHTS[term].initial);
+    }
+    if (fixed_mg < INT16_MIN || fixed_mg > INT16_MAX || fixed_eg < INT16_MIN || fixed_eg > INT16_MAX)
+        return false;
+    record.fixed_mg = static_cast<std::int16_t>(fixed_mg);
+    record.fixed_eg = static_cast<std::int16_t>(fixed_eg);
+    record.phase = static_cast<std::uint8_t>(std::clamp(eval_trace.phase, 0, Evaluation::MAX_PHASE));
+    record.result = result;
+    return true;
+}
+
+class FeatureWriter
+{
+public:
+    explicit FeatureWriter(const std::string &path) : out(path, std::ios::binary)
+    {
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header)); // Rewritten with the count at the end
+    }
+
+    ~FeatureWriter()
+    {
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    bool good() const { return out.good(); }
+    std::uint64_t count() const { return header.record_count; }
+
+    void add(const chess::Board &board, std::uint8_t result)
+    {
+        TuningRecord record;
+        if (!make_record(board, result, record))
+            return;
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        ++header.record_count;
+    }
+
+private:
+    std::ofstream out;
+    FeatureFileHeader header;
+};
+
+// Receives each position read from the input with White's result.
+using PositionSink = std::function<void(const chess::Board &, std::uint8_t)>;
+
+// Replays every game and hands its positions, with the game's result, to the sink.
+class TuningVisitor : public chess::pgn::Visitor
+{
+public:
+    explicit TuningVisitor(const PositionSink &sink) : sink(sink) {}
+
+    void startPgn() override
+    {
+        board.setFen(chess::constants::STARTPOS);
+        positions.clear();
+        result = -1;
+        ply = 0;
+        broken = false;
+    }
+
+    void header(std::string_view key, std::string_view value) override
+    {
+        if (key == "FEN")
+            board.setFen(value);
+        else if (key == "Result")
+            result = value == "1-0" ? 2 : value == "0-1" ? 0 : value == "1/2-1/2" ? 1 : -1;
+    }
+
+    void startMoves() override
+    {
+        if (result < 0)
+            skipPgn(true); // Unfinished or unknown result, nothing to learn from
+    }
+
+    void move(std::string_view san, std::string_view) override
+    {
+        if (broken)
+            return;
+        chess::Move move = chess::Move::NO_MOVE;
+        try
+        {
+            move = chess::uci::parseSan(board, san);
+        }
+        catch (const std::exception &)
+        {
+        }
+        if (move == chess::Move::NO_MOVE)
+        {
+            broken = true; // Keep the positions before the bad move, drop the rest of the game
+            return;
+        }
+        board.makeMove(move);
+        if (++ply > SKIP_PLIES)
+            positions.push_back(board);
+    }
+
+    void endPgn() override
+    {
+        if (result >= 0)
+            for (const chess::Board &position : positions)
+                sink(position, static_cast<std::uint8_t>(result));
+        ++games;
+    }
+
+    std::uint64_t games = 0;
+
+private:
+    const PositionSink &sink;
+    chess::Board board;
+    std::vector<chess::Board> positions;
+    int result = -1;
+    int ply = 0;
+    bool broken = false;
+};
+
+// EPD lines carry the result as c9 "1-0"; or [1.0] style annotations after the FEN.
+int epd_result(const std::string &line)
+{
+    if (line.find("\"1-0\"") != std::string::npos || line.find("[1.0]") != std::string::npos)
+        return 2;
+    if (line.find("\"0-1\"") != std::string::npos || line.find("[0.0]") != std::string::npos)
+        return 0;
+    if (line.find("\"1/2-1/2\"") != std::string::npos || line.find("[0.5]") != std::string::npos)
+        return 1;
+    return -1;
+}
+
+/*
+Reads positions with known results from a PGN file, an EPD file or a position file (.pos,
+see PositionRecord.hpp). Position files skip all parsing, so a large set of games is best
+packed once and extracted from the packed file after every change to the evaluation. */
+bool read_positions(const std::string &input_path, const PositionSink &sink)
+{
+    if (input_path.ends_with(".pos"))
+    {
+        PositionFile file(input_path);
+        if (file.records().empty())
+            return false;
+        EvalBoard board;
+        for (const PositionRecord &record : file.records())
+        {
+            if (record.result == PositionRecord::NO_RESULT)
+                continue;
+            board.load(record);
+            sink(board, record.result);
+        }
+        return true;
+    }
+
+    std::ifstream input(input_path, std::ios::binary);
+    if (!input)
+        return false;
+    if (input_path.ends_with(".epd"))
+    {
+        std::string line;
+        chess::Board board;
+        while (std::getline(input, line))
+        {
+            int result = epd_result(line);
+            if (result < 0)
+                continue;
+            // The first four fields are the position, the move counters are optional.
+            std::istringstream fields(line);
+            std::string fen, field;
+            for (int i = 0; i < 4 && fields >> field; ++i)
+                fen += (fen.empty() ? "" : " ") + field;
+            board.setFen(fen + " 0 1");
+            sink(board, static_cast<std::uint8_t>(result));
+        }
+    }
+    else
+    {
+        TuningVisitor visitor(sink);
+        chess::pgn::StreamParser parser(input);
+        parser.readGames(visitor);
+        std::cout << visitor.games << " games\n";
+    }
+    return true;
+}
+
+int extract(const std::string &input_path, const std::string &output_path)
+{
+    FeatureWriter writer(output_path);
+    if (!writer.good())
+    {
+        std::cerr << "Cannot write " << output_path << '\n';
+        return EXIT_FAILURE;
+    }
+    if (!read_positions(input_path, [&](const chess::Board &board, std::uint8_t result) { writer.add(board, result); }))
+    {
+        std::cerr << "Cannot read " << input_path << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << writer.count() << " positions written to " << output_path << '\n';
+    return EXIT_SUCCESS;
+}
+
+// Stores every position of the input, unfiltered, as a position file.
+int pack(const std::string &input_path, const std::string &output_path)
+{
+    PositionWriter writer(output_path);
+    if (!writer.good())
+    {
+        std::cerr << "Cannot write " << output_path << '\n';
+        return EXIT_FAILURE;
+    }
+    const bool read = read_positions(input_path, [&](const chess::Board &board, std::uint8_t result)
+                                     {
+                                         PositionRecord record = PositionRecord::from_board(board);
+                                         record.result = result;
+                                         writer.write(record);
+                                     });
+    if (!read)
+    {
+        std::cerr << "Cannot read " << input_path << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << writer.count() << " positions written to " << output_path << '\n';
+    return EXIT_SUCCESS;
+}
+
+// The feature file, mapped read-only.
+class FeatureFile
+{
+public:
+    explicit FeatureFile(const std::string &path) : file(path)
+    {
+        if (!file.data() || file.size() < sizeof(FeatureFileHeader))
+            return;
+        std::memcpy(&header, file.data(), sizeof(header));
+        const FeatureFileHeader expected;
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.term_count != EVAL_TERM_COUNT ||
+            sizeof(header) + header.record_count * sizeof(TuningRecord) > file.size())
+            header.record_count = 0; // Written by another version of the tuner, or truncated
+    }
+
+    std::size_t count() const { return header.record_count; }
+    const TuningRecord *records() const { return reinterpret_cast<const TuningRecord *>(file.data() + sizeof(header)); }
+
+private:
+    MappedFile file;
+    FeatureFileHeader header;
+};
+
+// Weights in floating point, [term][0 = mg, 1 = eg].
+using Weights = std::array<std::array<double, 2>, EVAL_TERM_COUNT>;
+
+double record_eval(const TuningRecord &record, const Weights &weights)
+{
+    double mg = record.fixed_mg, eg = record.fixed_eg;
+    for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+    {
+        mg += record.coefficients[term] * weights[term][0];
+        eg += record.coefficients[term] * weights[term][1];
+    }
+    return (mg * record.phase + eg * (Evaluation::MAX_PHASE - record.phase)) / Evaluation::MAX_PHASE;
+}
+
+double sigmoid(double k, double eval)
+{
+    return 1.0 / (1.0 + std::pow(10.0, -k * eval / 400.0));
+}
+
+/*
+Mean squared error over all records and, if gradient is given, its gradient by weight.
+Each thread sums over its own contiguous slice. */
+double evaluate_error(const FeatureFile &features, const Weights &weights, double k, int threads, Weights *gradient)
+{
+    const std::size_t n = features.count();
+    std::vector<double> errors(threads, 0.0);
+    std::vector<Weights> gradients(threads, Weights{});
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&, t]
+                             {
+            const std::size_t begin = n * t / threads, end = n * (t + 1) / threads;
+            const TuningRecord *records = features.records();
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const TuningRecord &record = records[i];
+                const double s = sigmoid(k, record_eval(record, weights));
+                const double diff = s - record.result / 2.0;
+                errors[t] += diff * diff;
+                if (!gradient)
+                    continue;
+                // d error / d eval, then split between the phases.
+                const double d = diff * s * (1 - s);
+                const double mg_share = d * record.phase / Evaluation::MAX_PHASE;
+                const double eg_share = d - mg_share;
+                for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+                {
+                    if (!record.coefficients[term])
+                        continue;
+                    gradients[t][term][0] += mg_share * record.coefficients[term];
+                    gradients[t][term][1] += eg_share * record.coefficients[term];
+                }
+            } });
+    for (std::thread &worker : workers)
+        worker.join();
+
+    double error = 0;
+    for (int t = 0; t < threads; ++t)
+        error += errors[t];
+    if (gradient)
+    {
+        *gradient = Weights{};
+        for (int t = 0; t < threads; ++t)
+            for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+                for (int phase = 0; phase < 2; ++phase)
+                    (*gradient)[term][phase] += gradients[t][term][phase] / n;
+    }
+    return error / n;
+}
+
+// The K that best maps the starting weights' evals to results, by ternary search.
+double fit_k(const FeatureFile &features, const Weights &weights, int threads)
+{
+    double low = 0.1, high = 4.0;
+    for (int i = 0; i < 40; ++i)
+    {
+        double a = low + (high - low) / 3, b = high - (high - low) / 3;
+        if (evaluate_error(features, weights, a, threads, nullptr) < evaluate_error(features, weights, b, threads, nullptr))
+            high = b;
+        else
+            low = a;
+    }
+    return (low + high) / 2;
+}
+
+bool write_weights(const std::string &path, const Weights &weights)
+{
+    std::ofstream out(path);
+    out << "#ifndef EVAL_WEIGHTS_HPP\n#define EVAL_WEIGHTS_HPP\n\n#include \"Score.hpp\"\n\n"
+        << "// Evaluation weights as (middlegame, endgame) pairs. tune.cpp writes this file; these are the tuned values.\n"
+        << "namespace EvalWeights\n{\n";
+    for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+    {
+        auto half = [&](int phase)
+        { return std::clamp(static_cast<int>(std::lround(weights[term][phase])), -32767, 32767); };
+        out << "    constexpr Score " << TUNABLE_WEIGHTS[term].name << " = make_score(" << half(0) << ", " << half(1) << ");\n";
+    }
+    out << "}\n\n#endif\n";
+    return out.good();
+}
+
+int run(const std::string &features_path, const std::string &output_path, int epochs, int threads)
+{
+    FeatureFile features(features_path);
+    if (!features.count())
+    {
+        std::cerr << "No positions in " << features_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    Weights weights;
+    for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+        weights[term] = {static_cast<double>(mg_value(TUNABLE_WEIGHTS[term].initial)), static_cast<double>(eg_value(TUNABLE_WEIGHTS[term].initial))};
+
+    const double k = fit_k(features, weights, threads);
+    std::cout << features.count() << " positions, K = " << std::setprecision(4) << k
+              << ", starting error " << std::setprecision(6) << evaluate_error(features, weights, k, threads, nullptr) << '\n';
+
+    // Adam. The step is in centipawns, the gradient is tiny in comparison.
+    constexpr double LEARNING_RATE = 1.0, BETA1 = 0.9, BETA2 = 0.999, EPSILON = 1e-8;
+    Weights m{}, v{}, gradient;
+    for (int epoch = 1; epoch <= epochs; ++epoch)
+    {
+        const double error = evaluate_error(features, weights, k, threads, &gradient);
+        for (int term = 0; term < EVAL_TERM_COUNT; ++term)
+            for (int phase = 0; phase < 2; ++phase)
+            {
+                const double g = gradient[term][phase];
+                m[term][phase] = BETA1 * m[term][phase] + (1 - BETA1) * g;
+                v[term][phase] = BETA2 * v[term][phase] + (1 - BETA2) * g * g;
+                const double m_hat = m[term][phase] / (1 - std::pow(BETA1, epoch));
+                const double v_hat = v[term][phase] / (1 - std::pow(BETA2, epoch));
+                weights[term][phase] -= LEARNING_RATE * m_hat / (std::sqrt(v_hat) + EPSILON);
+            }
+        if (epoch % 50 == 0 || epoch == epochs)
+            std::cout << "epoch " << epoch << " error " << std::setprecision(6) << error << '\n';
+    }
+
+    if (!write_weights(output_path, weights))
+    {
+        std::cerr << "Cannot write " << output_path << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "Weights written to " << output_path << '\n';
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "extract" && argc == 4)
+        return extract(argv[2], argv[3]);
+    if (mode == "pack" && argc == 4)
+        return pack(argv[2], argv[3]);
+    if (mode == "run" && argc >= 4)
+    {
+        const int epochs = argc > 4 ? std::stoi(argv[4]) : 1000;
+        const int threads = std::max(argc > 5 ? std::stoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency()), 1);
+        return run(argv[2], argv[3], epochs, threads);
+    }
+    std::cerr << "Usage:\n"
+              << "    tune pack <games.pgn|positions.epd> <positions.pos>\n"
+              << "    tune extract <games.pgn|positions.epd|positions.pos> <features.bin>\n"
+              << "    tune run <features.bin> <EvalWeights.hpp> [epochs] [threads]\n";
+    return EXIT_FAILURE;
+}
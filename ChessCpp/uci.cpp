@@ -0,0 +1,291 @@
+#include "chess.hpp"
+#include "Eval.hpp"
+#include "OpeningBook.hpp"
+#include "Search.hpp"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// UCI front end, so the engine can be run from a GUI or a tournament manager (cutechess, fastchess).
+// The search runs on a worker thread; the main thread keeps reading commands so "stop" and "isready" are answered at once.
+
+constexpr char STARTFEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Network mapped at startup if it is in the working directory. EvalFile points elsewhere.
+constexpr char DEFAULT_EVAL_FILE[] = "nnue.bin";
+
+class UciEngine
+{
+public:
+    UciEngine() : board(STARTFEN)
+    {
+        Nnue::network.open(DEFAULT_EVAL_FILE);
+        on_iteration = [this](const IterationReport &report)
+        {
+            send(to_uci_info(report));
+            if (json_stats)
+                send("info string json " + to_json(report));
+        };
+    }
+
+    ~UciEngine()
+    {
+        stop();
+    }
+
+    // Reads commands from std::cin until "quit" or end of input.
+    void loop()
+    {
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            std::istringstream input(line);
+            std::string command;
+            input >> command;
+
+            if (command == "uci")
+            {
+                send("id name Classical-Chess-Engine");
+                send("id author Vincent Guo");
+                send("option name Hash type spin default " + std::to_string(TranspositionTable::DEFAULT_SIZE_MB) + " min 1 max 65536");
+                send("option name Threads type spin default 1 min 1 max 256");
+                send("option name MultiPV type spin default 1 min 1 max " + std::to_string(MAX_MULTIPV));
+                send("option name JsonStats type check default false");
+                send("option name NullMove type check default true");
+                send("option name LMR type check default true");
+                send("option name ReverseFutility type check default true");
+                send("option name Futility type check default true");
+                send("option name LazyEval type check default true");
+                send("option name OwnBook type check default false");
+                send("option name BookFile type string default <empty>");
+                send(std::string("option name EvalFile type string default ") + DEFAULT_EVAL_FILE);
+                send("option name EvalBackend type combo default classical var classical var nnue");
+                if constexpr (SYZYGY_ENABLED)
+                    send("option name SyzygyPath type string default <empty>");
+                send("uciok");
+            }
+            else if (command == "isready")
+                send("readyok");
+            else if (command == "ucinewgame")
+            {
+                stop();
+                transposition_table.clear();
+                board.setFen(STARTFEN);
+            }
+            else if (command == "setoption")
+                setoption(input);
+            else if (command == "position")
+                position(input);
+            else if (command == "go")
+                go(input);
+            else if (command == "stop")
+                stop();
+            else if (command == "quit")
+                break;
+            else if (!command.empty())
+                send("info string unknown command " + command);
+        }
+        stop();
+    }
+
+private:
+    chess::Board board;
+    int threads = 1;
+    int multipv = 1;         // Best root moves reported, each with its own score and PV
+    bool json_stats = false; // Also print every iteration report as a JSON line
+    bool own_book = false;   // Play from opening_book while it has the position
+
+    std::thread worker;
+    std::mutex output_mutex;
+    std::mutex stop_mutex;
+    std::condition_variable stop_signal;
+    bool stop_requested = false;
+
+    // Output comes from both threads, so every line is written under a lock and flushed.
+    void send(const std::string &line)
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << line << std::endl;
+    }
+
+    // Ends the running search, if any, and waits for its bestmove to be sent.
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex);
+            stop_requested = true;
+        }
+        stop_signal.notify_all();
+        stop_search.store(true);
+        worker.join();
+        stop_search.store(false);
+    }
+
+    // setoption name <option> value <value>
+    void setoption(std::istringstream &input)
+    {
+        std::string token, name, value, rest;
+        input >> token >> name >> token >> value;
+        std::getline(input, rest); // File names may contain spaces
+        value += rest;
+        if (value.empty())
+            return;
+        stop();
+        try
+        {
+            if (name == "Hash")
+                transposition_table.resize(std::stoul(value));
+            else if (name == "Threads")
+                threads = std::max(std::stoi(value), 1);
+            else if (name == "MultiPV")
+                multipv = std::clamp(std::stoi(value), 1, MAX_MULTIPV);
+            else if (name == "JsonStats")
+                json_stats = value == "true";
+            else if (name == "NullMove")
+                search_options.null_move = value == "true";
+            else if (name == "LMR")
+                search_options.lmr = value == "true";
+            else if (name == "ReverseFutility")
+                search_options.reverse_futility = value == "true";
+            else if (name == "Futility")
+                search_options.futility = value == "true";
+            else if (name == "LazyEval")
+                search_options.lazy_eval = value == "true";
+            else if (name == "OwnBook")
+                own_book = value == "true";
+            else if (name == "EvalFile")
+            {
+                if (!Nnue::network.open(value == "<empty>" ? "" : value) && value != "<empty>")
+                    send("info string cannot read network " + value + ", expected " + std::to_string(Nnue::WEIGHT_BYTES) + " bytes of weights");
+                if (!Nnue::network.is_loaded())
+                    select_eval_backend(EvalBackend::CLASSICAL);
+            }
+            else if (name == "EvalBackend")
+            {
+                if (!select_eval_backend(value == "nnue" ? EvalBackend::NNUE : EvalBackend::CLASSICAL))
+                    send("info string no network loaded, set EvalFile first");
+            }
+            else if (name == "BookFile")
+            {
+                if (!opening_book.open(value == "<empty>" ? "" : value) && value != "<empty>")
+                    send("info string cannot read book " + value);
+            }
+            else if (name == "SyzygyPath")
+            {
+                if constexpr (!SYZYGY_ENABLED)
+                    send("info string tablebases need a build with -DUSE_SYZYGY");
+                else if (const int pieces = Tablebase::init(value))
+                    send("info string found " + std::to_string(pieces) + " piece tablebases");
+                else if (value != "<empty>")
+                    send("info string no tablebases found in " + value);
+            }
+            else
+                send("info string unknown option " + name);
+        }
+        catch (const std::exception &)
+        {
+            send("info string invalid value " + value + " for option " + name);
+        }
+    }
+
+    // position <startpos|fen <fen>> [moves <m1> ... <mn>]
+    void position(std::istringstream &input)
+    {
+        stop();
+        std::string token, fen;
+        input >> token;
+        if (token == "startpos")
+        {
+            fen = STARTFEN;
+            input >> token; // "moves", if any
+        }
+        else if (token == "fen")
+        {
+            while (input >> token && token != "moves")
+                fen += (fen.empty() ? "" : " ") + token;
+        }
+        else
+            return;
+
+        board.setFen(fen);
+        while (input >> token)
+        {
+            chess::Move move = chess::uci::uciToMove(board, token);
+            if (!is_legal(board, move))
+            {
+                send("info string illegal move " + token);
+                break;
+            }
+            board.makeMove(move);
+        }
+    }
+
+    // go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [depth <n>] [nodes <n>] [movetime <ms>] [infinite]
+    void go(std::istringstream &input)
+    {
+        stop();
+        SearchLimits limits;
+        limits.multipv = multipv;
+        std::string token;
+        while (input >> token)
+        {
+            if (token == "wtime")
+                input >> limits.wtime;
+            else if (token == "btime")
+                input >> limits.btime;
+            else if (token == "winc")
+                input >> limits.winc;
+            else if (token == "binc")
+                input >> limits.binc;
+            else if (token == "movestogo")
+                input >> limits.movestogo;
+            else if (token == "depth")
+                input >> limits.depth;
+            else if (token == "nodes")
+                input >> limits.nodes;
+            else if (token == "movetime")
+                input >> limits.movetime;
+            else if (token == "infinite")
+                limits.infinite = true;
+        }
+
+        // A book move is answered at once, without starting a search.
+        if (own_book && !limits.infinite)
+        {
+            const chess::Move book_move = opening_book.probe(board);
+            if (book_move != chess::Move::NO_MOVE)
+            {
+                send("info string book move");
+                send("bestmove " + chess::uci::moveToUci(book_move));
+                return;
+            }
+        }
+
+        stop_requested = false;
+        worker = std::thread([this, limits, search_board = board]() mutable
+                             {
+            chess::Move best_move = find_best_move(search_board, limits, threads);
+
+            // "go infinite" must not answer before the GUI says stop, even if the search ran out of depth.
+            if (limits.infinite)
+            {
+                std::unique_lock<std::mutex> lock(stop_mutex);
+                stop_signal.wait(lock, [this] { return stop_requested; });
+            }
+            send("bestmove " + (best_move == chess::Move::NO_MOVE ? std::string("0000") : chess::uci::moveToUci(best_move))); });
+    }
+};
+
+int main()
+{
+    std::ios::sync_with_stdio(false);
+    UciEngine engine;
+    engine.loop();
+    return 0;
+}